@@ -6,6 +6,16 @@ bool cullSwitch = true;
 bool lodSwitch = true;
 bool debugPyramidSwitch = false;
 uint32_t debugPyramidLevelInput = 0;
+bool traceCaptureRequest = false;
+bool benchmarkReportRequest = false;
+bool meshletCullSwitch = true;
+bool meshletCullVerifyRequest = false;
+bool visibilitySwitch = false;
+bool depthPrepassSwitch = false;
+bool lodFadeSwitch = false;
+bool bvhCullSwitch = true;
+bool clusterLodSwitch = false;
+uint32_t dynamicDrawLevel = 0;
 
 void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator) {
     auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
@@ -38,6 +48,46 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
         {
             debugPyramidSwitch = !debugPyramidSwitch;
         }
+        if (key == GLFW_KEY_T)
+        {
+            traceCaptureRequest = true;
+        }
+        if (key == GLFW_KEY_B)
+        {
+            benchmarkReportRequest = true;
+        }
+        if (key == GLFW_KEY_M)
+        {
+            meshletCullSwitch = !meshletCullSwitch;
+        }
+        if (key == GLFW_KEY_V)
+        {
+            meshletCullVerifyRequest = true;
+        }
+        if (key == GLFW_KEY_I)
+        {
+            visibilitySwitch = !visibilitySwitch;
+        }
+        if (key == GLFW_KEY_Z)
+        {
+            depthPrepassSwitch = !depthPrepassSwitch;
+        }
+        if (key == GLFW_KEY_F)
+        {
+            lodFadeSwitch = !lodFadeSwitch;
+        }
+        if (key == GLFW_KEY_H)
+        {
+            bvhCullSwitch = !bvhCullSwitch;
+        }
+        if (key == GLFW_KEY_G)
+        {
+            clusterLodSwitch = !clusterLodSwitch;
+        }
+        if (key == GLFW_KEY_D)
+        {
+            dynamicDrawLevel = (dynamicDrawLevel + 1) % 4;
+        }
         if (key >= GLFW_KEY_0 && key <= GLFW_KEY_9)
         {
             debugPyramidLevelInput = key - GLFW_KEY_0;
@@ -77,7 +127,10 @@ void renderApplication::initVulkan() {
     pickPhysicalDevice();
     createLogicalDevice();
     createSwapChain();
-    createRenderPass();
+    createRenderPass(swapChainImageFormat, VK_ATTACHMENT_LOAD_OP_CLEAR, renderPass);
+    createRenderPass(VK_FORMAT_R32G32_UINT, VK_ATTACHMENT_LOAD_OP_CLEAR, renderPassVisibility);
+    createRenderPass(swapChainImageFormat, VK_ATTACHMENT_LOAD_OP_LOAD, renderPassEqual);
+    createRenderPassDepth();
     createRenderPassLate();
     createGraphicsPipeline();
     createCommandPool();
@@ -93,19 +146,76 @@ void renderApplication::mainLoop() {
         queryEnabled = querySwitch;
         cullEnabled = cullSwitch;
         lodEnabled = lodSwitch;
+        meshletCullEnabled = meshletCullSwitch;
+        visibilityEnabled = visibilitySwitch;
+        depthPrepassEnabled = depthPrepassSwitch;
+        lodFadeEnabled = lodFadeSwitch;
+        bvhCullEnabled = bvhCullSwitch;
+        clusterLodEnabled = clusterLodSwitch;
+        dynamicDrawFraction = dynamicDrawLevel == 0 ? 0.f : dynamicDrawLevel == 1 ? 0.01f : dynamicDrawLevel == 2 ? 0.1f : 1.f;
         debugPyramid = debugPyramidSwitch;
         debugPyramidLevel = debugPyramidLevelInput;
+        if (traceCaptureRequest && !profileTrace.isCapturing())
+        {
+            // gpu scopes only exist while queries are enabled
+            querySwitch = queryEnabled = true;
+            profileTrace.beginCapture(60, "niagara_trace.json");
+        }
+        traceCaptureRequest = false;
+
         double frameCPUBegin = glfwGetTime() * 1000;
-        glfwPollEvents();
-        drawFrame();
+        {
+            CpuScope frameScope(profileTrace, "frame");
+            {
+                CpuScope pollScope(profileTrace, "pollEvents");
+                glfwPollEvents();
+            }
+            drawFrame();
+        }
         double frameCPUEnd = glfwGetTime() * 1000;
         frameCPUAvg = frameCPUAvg * 0.95 + (frameCPUEnd - frameCPUBegin) * 0.05;
+
+        profileTrace.endFrame();
+
+        if (benchmarkReportRequest)
+        {
+            if (queryEnabled)
+            {
+                writeBenchmarkReport("niagara_benchmark.json");
+            }
+            else
+            {
+                std::cout << "benchmark report needs queries, press Q first" << std::endl;
+            }
+            benchmarkReportRequest = false;
+        }
+
+        if (meshletCullVerifyRequest)
+        {
+            if (visibilityEnabled)
+            {
+                verifyVisibilityBuffer();
+            }
+            if (meshletCullEnabled && !(rtxEnabled && rtxSupported))
+            {
+                verifyMeshletCull();
+            }
+            else if (!visibilityEnabled)
+            {
+                std::cout << "meshlet cull verification needs the compute path, turn mesh shading off with R" << std::endl;
+            }
+            meshletCullVerifyRequest = false;
+        }
+
+        const RollingStatistics* frameGPUStats = gpuProfiler.getStatistics("frame");
+        const RollingStatistics* cullGPUStats = gpuProfiler.getStatistics("cull");
+        double frameGPUAvg = frameGPUStats ? frameGPUStats->average() : 0.0;
         double trianglesPerSec = frameGPUAvg > 0.f ? double(triangleCount) / double(frameGPUAvg * 1e-3) : 0.f;
         double meshPerSec = frameGPUAvg > 0.f ? double(drawCount) / double(frameGPUAvg * 1e-3) : 0.f;
-        char title[256];
-        sprintf(title, "cpu: %.1f ms; gpu: %.3f ms (cull: %.2f ms); triangles %.1fM; mesh shading %s; %.1fB tri/sec; show query %s; culling %s; lod %s",
-            frameCPUAvg, frameGPUAvg, cullGPUTime, double(triangleCount) * 1e-6, rtxEnabled ? "ON" : "OFF", 
-            trianglesPerSec * 1e-9, queryEnabled ? "ON" : "OFF", cullEnabled ? "ON" : "OFF", lodEnabled ? "ON" : "OFF");
+        char title[512];
+        sprintf(title, "cpu: %.1f ms; gpu: %.3f ms [%.3f..%.3f] (cull: %.2f ms); triangles %.1fM; mesh shading %s; %.1fB tri/sec; show query %s; culling %s; lod %s; meshlet cull %s; visibility buffer %s; depth prepass %s; lod fade %s; bvh cull %s; cluster lod %s; dynamic %.0f%%",
+            frameCPUAvg, frameGPUAvg, frameGPUStats ? frameGPUStats->minimum() : 0.0, frameGPUStats ? frameGPUStats->maximum() : 0.0, cullGPUStats ? cullGPUStats->average() : 0.0, double(triangleCount) * 1e-6, rtxEnabled ? (meshShaderEXT ? "EXT" : "NV") : "OFF", 
+            trianglesPerSec * 1e-9, queryEnabled ? "ON" : "OFF", cullEnabled ? "ON" : "OFF", lodEnabled ? "ON" : "OFF", meshletCullEnabled ? "ON" : "OFF", visibilityEnabled ? "ON" : "OFF", depthPrepassEnabled ? "ON" : "OFF", lodFadeEnabled ? "ON" : "OFF", bvhCullEnabled ? "ON" : "OFF", clusterLodEnabled ? "ON" : "OFF", dynamicDrawFraction * 100.f);
         glfwSetWindowTitle(window, title);
     }
 
@@ -113,40 +223,54 @@ void renderApplication::mainLoop() {
 }
 
 void renderApplication::cleanup() {
-    vkDestroyQueryPool(device, queryPool, nullptr);
+    if (drawBvhRebuild.valid())
+    {
+        drawBvhRebuild.wait();
+    }
+
+    gpuProfiler.destroy(device);
     vkDestroyQueryPool(device, pipeStatsQueryPool, nullptr);
+    destroyBuffer(csb, device);
+    destroyBuffer(csrb, device);
     for (size_t i = 0; i < meshes.size(); ++i)
     {
         meshes[i].destroyRenderData(device);
     }
 
     destroyShader(drawcullCS);
+    destroyShader(bvhcullCS);
     destroyShader(depthreduceCS);
+    destroyShader(meshletcullCS);
+    destroyShader(visresolveCS);
+    destroyShader(scatterCS);
 
     vkDestroySampler(device, depthSampler, nullptr);
 
     destroyBuffer(db, device);
     destroyBuffer(dcb, device);
     destroyBuffer(dccb, device);
+    destroyBuffer(dlsb, device);
+    destroyBuffer(bnb, device);
+    destroyBuffer(blb, device);
+    destroyBuffer(bvlb, device);
+    destroyBuffer(bob, device);
+    drawUpdates.destroy(device);
+    orderUpdates.destroy(device);
+    leafUpdates.destroy(device);
+    nodeUpdates.destroy(device);
+    destroyBuffer(mcdb, device);
+    destroyBuffer(mcib, device);
 
-    if (depthPyramid.image)
-    {
-        for (uint32_t i = 0; i < depthPyramidLevels; ++i)
-        {
-            vkDestroyImageView(device, depthPyramidMips[i], 0);
-        }
-        destroyImage(depthPyramid, device);
-    }
-
-    destroyImage(colorTarget, device);
-    destroyImage(depthTarget, device);
-    vkDestroyFramebuffer(device, targetFB, 0);
+    destroyRenderTargets();
 
     cleanupSwapChain();
 
     if (rtxSupported)
     {
         vkDestroyPipeline(device, rtxGraphicsPipeline, nullptr);
+        vkDestroyPipeline(device, rtxVisibilityPipeline, nullptr);
+        vkDestroyPipeline(device, rtxGraphicsFadePipeline, nullptr);
+        vkDestroyPipeline(device, rtxVisibilityFadePipeline, nullptr);
         destroyProgram(rtxGraphicsProgram);
     }
 
@@ -155,12 +279,33 @@ void renderApplication::cleanup() {
 
     vkDestroyPipeline(device, drawcmdPipeline, nullptr);
     destroyProgram(drawcmdProgram);
+    vkDestroyPipeline(device, bvhcullPipeline, nullptr);
+    destroyProgram(bvhcullProgram);
+
+    vkDestroyPipeline(device, meshletcullPipeline, nullptr);
+    destroyProgram(meshletcullProgram);
+
+    vkDestroyPipeline(device, visresolvePipeline, nullptr);
+    destroyProgram(visresolveProgram);
+
+    vkDestroyPipeline(device, scatterPipeline, nullptr);
+    destroyProgram(scatterProgram);
 
     vkDestroyPipeline(device, graphicsPipeline, nullptr);
+    vkDestroyPipeline(device, visibilityPipeline, nullptr);
+    vkDestroyPipeline(device, graphicsEqualPipeline, nullptr);
+    vkDestroyPipeline(device, graphicsFadePipeline, nullptr);
+    vkDestroyPipeline(device, visibilityFadePipeline, nullptr);
     destroyProgram(graphicsProgram);
 
+    vkDestroyPipeline(device, depthPipeline, nullptr);
+    destroyProgram(depthProgram);
+
     vkDestroyRenderPass(device, renderPass, nullptr);
     vkDestroyRenderPass(device, renderPassLate, nullptr);
+    vkDestroyRenderPass(device, renderPassVisibility, nullptr);
+    vkDestroyRenderPass(device, renderPassEqual, nullptr);
+    vkDestroyRenderPass(device, renderPassDepth, nullptr);
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
@@ -4,12 +4,37 @@
 #include "niagara_prereq.h"
 #include "common_helper.h"
 #include "mesh.h"
+#include "profiler.h"
+#include "scene.h"
+#include "buffer_update.h"
 
 const uint32_t WIDTH = 1600;
 const uint32_t HEIGHT = 1200;
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
+#define PIPESTATSMAXCOUNT 8
+
+// size of the compacted index region written by meshletcull.comp
+#define MESHLETCULLINDEXCOUNT (1 << 24)
+
+// pipeline statistics are returned in the order of their bits, so this table is sorted by flag value
+struct PipelineStatistic
+{
+    VkQueryPipelineStatisticFlagBits flag;
+    const char* name;
+};
+
+const PipelineStatistic pipelineStatistics[] = {
+    { VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT, "vertexShaderInvocations" },
+    { VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT, "clippingInvocations" },
+    { VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT, "clippingPrimitives" },
+    { VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT, "fragmentShaderInvocations" },
+    { VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT, "computeShaderInvocations" },
+    { VK_QUERY_PIPELINE_STATISTIC_TASK_SHADER_INVOCATIONS_BIT_EXT, "taskShaderInvocations" },
+    { VK_QUERY_PIPELINE_STATISTIC_MESH_SHADER_INVOCATIONS_BIT_EXT, "meshShaderInvocations" },
+};
+
 const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
 };
@@ -33,6 +58,13 @@ class renderApplication {
 public:
     void run();
 
+    // loads the assets without creating a window or device and writes per lod geometry statistics
+    void writeAssetReport(const char* path);
+    void runOverdrawBenchmark();
+    void runBvhRefitBenchmark();
+    void runClusterDagVerify();
+    void runMeshletBenchmark();
+
 private:
     GLFWwindow* window;
 
@@ -57,26 +89,66 @@ private:
     uint32_t depthPyramidLevels;
     VkImageView depthPyramidMips[16];
     VkFramebuffer targetFB;
+    VkFramebuffer depthFB;
+
+    // visibility buffer mode: the main pass writes (drawId, triangle) ids, visresolve.comp shades them into resolveTarget
+    Image visibilityTarget;
+    Image resolveTarget;
+    VkFramebuffer visibilityFB;
 
     VkRenderPass renderPass;
     VkRenderPass renderPassLate;
+    VkRenderPass renderPassVisibility;
+    VkRenderPass renderPassDepth;
+    VkRenderPass renderPassEqual;
 
     VkPipelineCache pipelineCache = 0;
 
     VkPipeline graphicsPipeline;
     Program graphicsProgram;
 
+    // depth prepass for the vertex path: position only depth writes, then color with an EQUAL test and no depth writes
+    VkPipeline depthPipeline;
+    Program depthProgram;
+    VkPipeline graphicsEqualPipeline;
+
     VkPipeline rtxGraphicsPipeline;
     Program rtxGraphicsProgram;
 
+    // the id pipelines reuse the layouts of graphicsProgram and rtxGraphicsProgram, visibility.frag has no resources
+    VkPipeline visibilityPipeline;
+    VkPipeline rtxVisibilityPipeline;
+
+    // LOD_FADE variants of the main pass with the dither discard, only bound while lod fading is on
+    VkPipeline graphicsFadePipeline;
+    VkPipeline visibilityFadePipeline;
+    VkPipeline rtxGraphicsFadePipeline;
+    VkPipeline rtxVisibilityFadePipeline;
+
     VkPipeline drawcmdPipeline;
     Program drawcmdProgram;
 
+    VkPipeline bvhcullPipeline;
+    Program bvhcullProgram;
+
     VkPipeline depthreducePipeline;
     Program depthreduceProgram;
 
+    VkPipeline meshletcullPipeline;
+    Program meshletcullProgram;
+
+    VkPipeline visresolvePipeline;
+    Program visresolveProgram;
+
+    VkPipeline scatterPipeline;
+    Program scatterProgram;
+
     Shader drawcullCS;
+    Shader bvhcullCS;
     Shader depthreduceCS;
+    Shader meshletcullCS;
+    Shader visresolveCS;
+    Shader scatterCS;
 
     VkCommandPool commandPool;
     std::vector<VkCommandBuffer> commandBuffers;
@@ -91,21 +163,31 @@ private:
     std::vector<Mesh> meshes;
     std::vector<MeshDraw> draws;
 
-    VkQueryPool queryPool;
-    uint64_t queryResults[4];
+    // one slice of QUERYCOUNT timestamps and one pipeline statistics query per frame in flight
+    GpuProfiler gpuProfiler;
+    ProfileTrace profileTrace;
 
     VkQueryPool pipeStatsQueryPool;
-    uint32_t pipeStatsQueryResults[1];
+    VkQueryPipelineStatisticFlags pipeStatsFlags = 0;
+    uint32_t pipeStatsCount = 0;
+    uint64_t pipeStatsQueryResults[PIPESTATSMAXCOUNT];
+
+    // culling counters are reset every frame and copied into one readback slice per frame in flight
+    Buffer csb;
+    Buffer csrb;
+    CullStatistics cullStatistics = {};
+
+    bool queryPending[MAX_FRAMES_IN_FLIGHT] = {};
+    // -1 when the frame didn't draw through the forward vertex path, otherwise whether it used the depth prepass
+    int queryDepthPrepass[MAX_FRAMES_IN_FLIGHT] = {};
+
+    // last fragment shader invocation count of the forward vertex path without [0] and with [1] the depth prepass
+    uint64_t fragmentInvocations[2] = {};
 
     bool queryEnabled = false;
     float timestampPeriod;
-    double frameGPUBegin;
-    double frameGPUEnd;
 
     double frameCPUAvg;
-    double frameGPUAvg;
-
-    double cullGPUTime;
 
     uint32_t drawCount = 100;
     uint32_t triangleCount = 0;
@@ -113,16 +195,63 @@ private:
     Buffer dcb;
     Buffer dccb;
 
+    // a draw crossing a lod boundary emits a command for both lods while it fades, so command buffers hold two per draw
+    uint32_t drawCommandCapacity = 0;
+    Buffer dlsb;
+
+    // bvh over the spatially sorted draws: node and leaf boxes, and the leaves that survived bvhcull.comp this frame
+    Buffer bnb;
+    Buffer blb;
+    Buffer bvlb;
+    Buffer bob;
+    uint32_t drawBvhNodeCount = 0;
+    DrawBvh drawBvh;
+
+    // a background rebuild works on a snapshot, draws moved meanwhile are refit into the new tree before it is swapped in
+    std::future<DrawBvh> drawBvhRebuild;
+    std::vector<uint8_t> drawBvhRebuildDirty;
+
+    // dynamic draws: D cycles the share of draws that move every frame
+    float dynamicDrawFraction = 0.f;
+    float dynamicDrawSelected = 0.f;
+    std::vector<uint32_t> dynamicDraws;
+    std::vector<glm::vec3> dynamicVelocities;
+    double dynamicDrawTime = 0.0;
+
+    // draws, order, leaves and nodes changed on the cpu reach the gpu as coalesced ranges at the start of the next frame
+    BufferUpdater drawUpdates;
+    BufferUpdater orderUpdates;
+    BufferUpdater leafUpdates;
+    BufferUpdater nodeUpdates;
+
+    // meshlet culling for the vertex pipeline: one indexed draw per draw command over a compacted index buffer
+    Buffer mcdb;
+    Buffer mcib;
+    MeshletCullData meshletCullData = {};
+
+    VisibilityResolveData visibilityResolveData = {};
+
+    // rtxSupported means either mesh shading extension is available, meshShaderEXT picks VK_EXT_mesh_shader over VK_NV_mesh_shader
     bool rtxSupported = false;
     bool rtxEnabled = false;
+    bool meshShaderEXT = false;
+    bool meshShaderQueries = false;
 
     bool cullEnabled = false;
     bool lodEnabled = false;
+    bool meshletCullEnabled = false;
+    bool visibilityEnabled = false;
+    bool depthPrepassEnabled = false;
+    bool lodFadeEnabled = false;
+    bool bvhCullEnabled = false;
+    bool clusterLodEnabled = false; // only the mesh shading and meshletcull.comp paths select a cut, the plain vertex path would draw lod 0
+    float clusterLodThreshold = 1.f; // projected cluster error in pixels
 
     bool debugPyramid = false;
     uint32_t debugPyramidLevel = 0;
 
     float drawDistance;
+    float sceneRadius;
 
     VkSampler depthSampler;
 
@@ -140,6 +269,17 @@ private:
 
     void recreateSwapChain();
 
+    void loadMeshes(bool analyzeIndexOrder = false);
+    void generateDraws();
+
+    void selectDynamicDraws(float fraction);
+    void moveDynamicDraws(float deltaTime);
+
+    // the mesh and its lod history stay, so only the transform of a draw can change after createMeshes
+    void setDrawTransform(uint32_t draw, const glm::vec3& position, float scale, const glm::quat& rotation);
+    void updateDraws();
+    void recordDrawUpdates(VkCommandBuffer commandBuffer);
+
     void createMeshes();
 
     void createInstance();
@@ -156,13 +296,15 @@ private:
 
     void createSwapChain();
 
-    void createRenderPass();
+    void createRenderPass(VkFormat colorFormat, VkAttachmentLoadOp depthLoadOp, VkRenderPass& outRenderPass);
+
+    void createRenderPassDepth();
 
     void createRenderPassLate();
     
     void createGenericGraphicsPipelineLayout(Shaders shaders, VkShaderStageFlags pushConstantStages, VkPipelineLayout& outPipelineLayout, VkDescriptorSetLayout inSetLayout, size_t pushConstantSize);
 
-    void createGenericGraphicsPipeline(Shaders shaders, VkPipelineCache pipelineCache, VkPipelineLayout inPipelineLayout, VkPipeline& outPipeline);
+    void createGenericGraphicsPipeline(Shaders shaders, VkPipelineCache pipelineCache, VkPipelineLayout inPipelineLayout, VkRenderPass inRenderPass, VkPipeline& outPipeline, VkCompareOp depthCompareOp = VK_COMPARE_OP_GREATER, bool depthWriteEnable = true);
 
     void createComputePipeline(VkPipelineCache pipelineCache, const Shader& shader, VkPipelineLayout inPipelineLayout, VkPipeline& outPipeline);
     
@@ -186,6 +328,18 @@ private:
 
     void createQueryPool();
 
+    void readQueryResults(uint32_t frameIndex);
+
+    void writeBenchmarkReport(const char* path);
+
+    void verifyMeshletCull();
+
+    void verifyVisibilityBuffer();
+
+    void createRenderTargets();
+
+    void destroyRenderTargets();
+
     void drawFrame();
 
     bool createShader(Shader& shader, const std::vector<char>& code);
@@ -203,6 +357,7 @@ private:
     bool isDeviceSuitable(VkPhysicalDevice device);
 
     bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+    void selectMeshShadingPath(VkPhysicalDevice device);
 
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
 
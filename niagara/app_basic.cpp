@@ -1,20 +1,25 @@
 #include "app.h"
 
-void renderApplication::createMeshes()
+void renderApplication::loadMeshes(bool analyzeIndexOrder)
 {
     meshes.resize(1);
-    meshes[0].rtxSupported = rtxSupported;
-    //meshes[0].loadMesh("..\\extern\\common-3d-test-models\\data\\xyzrgb_dragon.obj");
-    meshes[0].loadMesh("..\\kitten.obj", rtxSupported);
-    //meshes[0].loadMesh("..\\extern\\common-3d-test-models\\data\\suzanne.obj", rtxSupported);
 
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    // per asset build settings; meshlets are built even without mesh shading, meshletcull.comp uses them to compact the index buffer
+    MeshBuildSettings kittenSettings;
+    kittenSettings.buildMeshlets = true;
+    kittenSettings.meshletStrategy = MESHLET_STRATEGY_CULL;
+    kittenSettings.meshletConeWeight = 1.f;
+    kittenSettings.analyzeIndexOrder = analyzeIndexOrder;
 
-    meshes[0].generateRenderData(device, commandBuffers[0], graphicsQueue, memProperties);
+    //meshes[0].loadMesh("..\\extern\\common-3d-test-models\\data\\xyzrgb_dragon.obj", MeshBuildSettings());
+    meshes[0].loadMesh("..\\kitten.obj", kittenSettings);
+    //meshes[0].loadMesh("..\\extern\\common-3d-test-models\\data\\suzanne.obj", MeshBuildSettings());
+}
 
+void renderApplication::generateDraws()
+{
     drawCount = 1000000;
-    float sceneRadius = 300.f;
+    sceneRadius = 300.f;
     drawDistance = 200.f;
 
     draws.resize(drawCount);
@@ -50,16 +55,76 @@ void renderApplication::createMeshes()
         //draws[i].commandIndirectMS.taskCount = (mesh.meshletCount + 31) / 32;
         //triangleCount += mesh.lods[0].indexCount / 3;
     }
+
+    // rand() order scatters neighbouring culling threads across the scene
+    sortDrawsSpatially(draws);
+}
+
+void renderApplication::createMeshes()
+{
+    loadMeshes();
+
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    meshes[0].generateRenderData(device, commandBuffers[0], graphicsQueue, memProperties);
+
+    generateDraws();
+
     Buffer scratch = {};
     createBuffer(scratch, device, memProperties, sizeof(draws[0]) * draws.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
     createBuffer(db, device, memProperties, sizeof(draws[0]) * draws.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-    createBuffer(dcb, device, memProperties, sizeof(MeshDrawCommand) * draws.size(), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    drawCommandCapacity = uint32_t(draws.size() * 2);
 
-    createBuffer(dccb, device, memProperties, 4, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    createBuffer(dcb, device, memProperties, sizeof(MeshDrawCommand) * drawCommandCapacity, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    createBuffer(dccb, device, memProperties, sizeof(DrawCommandCount), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
     uploadBuffer(device, commandBuffers[0], graphicsQueue, db, scratch, draws.data(), draws.size() * sizeof(MeshDraw));
 
+    // every draw starts without a lod history and snaps to its first lod
+    std::vector<DrawLodState> lodStates(draws.size(), { 0xff, 0xff, 0, 0 });
+
+    createBuffer(dlsb, device, memProperties, sizeof(DrawLodState) * draws.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    uploadBuffer(device, commandBuffers[0], graphicsQueue, dlsb, scratch, lodStates.data(), lodStates.size() * sizeof(DrawLodState));
+
+    // the order and both levels are smaller than the draws, so they go through the same scratch buffer
+    drawBvh.build(draws, meshes[0].m_instances);
+
+    const std::vector<DrawBvhNode>& bvhNodes = drawBvh.nodes;
+    const std::vector<DrawBvhNode>& bvhLeaves = drawBvh.leaves;
+
+    drawBvhNodeCount = uint32_t(bvhNodes.size());
+
+    createBuffer(bob, device, memProperties, sizeof(uint32_t) * draws.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    uploadBuffer(device, commandBuffers[0], graphicsQueue, bob, scratch, drawBvh.order.data(), drawBvh.order.size() * sizeof(uint32_t));
+
+    createBuffer(bnb, device, memProperties, sizeof(DrawBvhNode) * bvhNodes.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    uploadBuffer(device, commandBuffers[0], graphicsQueue, bnb, scratch, bvhNodes.data(), bvhNodes.size() * sizeof(DrawBvhNode));
+
+    createBuffer(blb, device, memProperties, sizeof(DrawBvhNode) * bvhLeaves.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    uploadBuffer(device, commandBuffers[0], graphicsQueue, blb, scratch, bvhLeaves.data(), bvhLeaves.size() * sizeof(DrawBvhNode));
+
+    createBuffer(bvlb, device, memProperties, sizeof(VisibleLeafHeader) + sizeof(uint32_t) * bvhLeaves.size(), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    drawUpdates.create(device, memProperties, db, sizeof(MeshDraw), MAX_FRAMES_IN_FLIGHT);
+    orderUpdates.create(device, memProperties, bob, sizeof(uint32_t), MAX_FRAMES_IN_FLIGHT);
+    leafUpdates.create(device, memProperties, blb, sizeof(DrawBvhNode), MAX_FRAMES_IN_FLIGHT);
+    nodeUpdates.create(device, memProperties, bnb, sizeof(DrawBvhNode), MAX_FRAMES_IN_FLIGHT);
+
+    drawBvhRebuildDirty.assign(draws.size(), 0);
+
+    destroyBuffer(scratch, device);
+
+    // the compacted index buffer starts with a copy of the mesh indices, draws that don't fit into MESHLETCULLINDEXCOUNT fall back to them
+    const std::vector<uint32_t>& meshIndices = meshes[0].m_indices;
+
+    createBuffer(mcdb, device, memProperties, sizeof(MeshDrawCommand) * drawCommandCapacity, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    createBuffer(mcib, device, memProperties, sizeof(uint32_t) * (meshIndices.size() + MESHLETCULLINDEXCOUNT), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    createBuffer(scratch, device, memProperties, sizeof(uint32_t) * meshIndices.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    uploadBuffer(device, commandBuffers[0], graphicsQueue, mcib, scratch, meshIndices.data(), sizeof(uint32_t) * meshIndices.size());
     destroyBuffer(scratch, device);
 }
 
@@ -110,10 +175,10 @@ void renderApplication::createInstance() {
     volkLoadInstance(instance);
 }
 
-void renderApplication::createRenderPass() {
+void renderApplication::createRenderPass(VkFormat colorFormat, VkAttachmentLoadOp depthLoadOp, VkRenderPass& outRenderPass) {
     VkAttachmentDescription attachments[2] = {};
 
-    attachments[0].format = swapChainImageFormat;
+    attachments[0].format = colorFormat;
     attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
     attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
@@ -124,7 +189,7 @@ void renderApplication::createRenderPass() {
 
     attachments[1].format = VK_FORMAT_D32_SFLOAT;
     attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
-    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].loadOp = depthLoadOp;
     attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -162,7 +227,39 @@ void renderApplication::createRenderPass() {
     renderPassInfo.dependencyCount = 1;
     renderPassInfo.pDependencies = &dependency;
 
-    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &outRenderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render pass!");
+    }
+}
+
+void renderApplication::createRenderPassDepth()
+{
+    VkAttachmentDescription attachment = {};
+    attachment.format = VK_FORMAT_D32_SFLOAT;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = 0;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &attachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+
+    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPassDepth) != VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass!");
     }
 }
@@ -254,6 +351,27 @@ void renderApplication::createCommandBuffers() {
 
 void renderApplication::createQueryPool()
 {
-    queryPool = createGenericQueryPool(device, QUERYCOUNT, VK_QUERY_TYPE_TIMESTAMP);
-    pipeStatsQueryPool = createGenericQueryPool(device, 1, VK_QUERY_TYPE_PIPELINE_STATISTICS);
+    gpuProfiler.create(device, MAX_FRAMES_IN_FLIGHT, timestampPeriod);
+
+    pipeStatsFlags = 0;
+    pipeStatsCount = 0;
+    for (const PipelineStatistic& statistic : pipelineStatistics)
+    {
+        if (!meshShaderQueries && (statistic.flag & (VK_QUERY_PIPELINE_STATISTIC_TASK_SHADER_INVOCATIONS_BIT_EXT | VK_QUERY_PIPELINE_STATISTIC_MESH_SHADER_INVOCATIONS_BIT_EXT)))
+        {
+            continue;
+        }
+
+        pipeStatsFlags |= statistic.flag;
+        pipeStatsCount++;
+    }
+    assert(pipeStatsCount <= PIPESTATSMAXCOUNT);
+
+    pipeStatsQueryPool = createGenericQueryPool(device, MAX_FRAMES_IN_FLIGHT, VK_QUERY_TYPE_PIPELINE_STATISTICS, pipeStatsFlags);
+
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    createBuffer(csb, device, memProperties, sizeof(CullStatistics), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    createBuffer(csrb, device, memProperties, sizeof(CullStatistics) * MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 }
\ No newline at end of file
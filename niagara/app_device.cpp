@@ -77,6 +77,11 @@ void renderApplication::createLogicalDevice() {
     featuresMesh.taskShader = true;
     featuresMesh.meshShader = true;
 
+    VkPhysicalDeviceMeshShaderFeaturesEXT featuresMeshEXT = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT };
+    featuresMeshEXT.taskShader = true;
+    featuresMeshEXT.meshShader = true;
+    featuresMeshEXT.meshShaderQueries = meshShaderQueries;
+
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -93,13 +98,13 @@ void renderApplication::createLogicalDevice() {
 
     if (rtxSupported)
     {
-        features13.pNext = &featuresMesh;
+        features13.pNext = meshShaderEXT ? (void*)&featuresMeshEXT : (void*)&featuresMesh;
     }
 
     std::vector<const char*> wantedExtensions(deviceExtensions);
     if (rtxSupported)
     {
-        wantedExtensions.push_back(VK_NV_MESH_SHADER_EXTENSION_NAME);
+        wantedExtensions.push_back(meshShaderEXT ? VK_EXT_MESH_SHADER_EXTENSION_NAME : VK_NV_MESH_SHADER_EXTENSION_NAME);
     }
 
     createInfo.enabledExtensionCount = static_cast<uint32_t>(wantedExtensions.size());
@@ -132,7 +137,54 @@ bool renderApplication::isDeviceSuitable(VkPhysicalDevice device) {
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
 
-    return indices.isComplete() && extensionsSupported && swapChainAdequate;
+    bool suitable = indices.isComplete() && extensionsSupported && swapChainAdequate;
+
+    if (suitable)
+    {
+        selectMeshShadingPath(device);
+    }
+
+    return suitable;
+}
+
+void renderApplication::selectMeshShadingPath(VkPhysicalDevice device) {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    bool extSupported = false;
+    bool nvSupported = false;
+
+    for (const auto& extension : availableExtensions) {
+        if (std::strcmp(extension.extensionName, VK_EXT_MESH_SHADER_EXTENSION_NAME) == 0)
+        {
+            extSupported = true;
+        }
+        if (std::strcmp(extension.extensionName, VK_NV_MESH_SHADER_EXTENSION_NAME) == 0)
+        {
+            nvSupported = true;
+        }
+    }
+
+    if (extSupported)
+    {
+        VkPhysicalDeviceMeshShaderFeaturesEXT featuresMeshEXT = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT };
+        VkPhysicalDeviceFeatures2 features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+        features.pNext = &featuresMeshEXT;
+        vkGetPhysicalDeviceFeatures2(device, &features);
+
+        extSupported = featuresMeshEXT.taskShader && featuresMeshEXT.meshShader;
+        meshShaderQueries = extSupported && featuresMeshEXT.meshShaderQueries;
+    }
+
+    // the EXT path runs on every vendor, the NV one is kept for drivers that only expose the older extension
+    meshShaderEXT = extSupported;
+    rtxSupported = extSupported || nvSupported;
+    rtxEnabled = rtxSupported;
+
+    std::cout << "mesh shading: " << (meshShaderEXT ? "VK_EXT_mesh_shader" : nvSupported ? "VK_NV_mesh_shader" : "not supported") << std::endl;
 }
 
 QueueFamilyIndices renderApplication::findQueueFamilies(VkPhysicalDevice device) {
@@ -192,12 +244,7 @@ bool renderApplication::checkDeviceExtensionSupport(VkPhysicalDevice device) {
 
     for (const auto& extension : availableExtensions) {
         requiredExtensions.erase(extension.extensionName);
-        if (std::strcmp(extension.extensionName, VK_NV_MESH_SHADER_EXTENSION_NAME))
-        {
-            rtxSupported = true;
-        }
     }
-    rtxEnabled = rtxSupported;
 
     return requiredExtensions.empty();
 }
\ No newline at end of file
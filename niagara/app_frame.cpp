@@ -11,19 +11,29 @@ void renderApplication::recordCommandBuffer(VkCommandBuffer commandBuffer, uint3
 
     if (queryEnabled)
     {
-        vkCmdResetQueryPool(commandBuffer, queryPool, 0, QUERYCOUNT);
-        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 0);
-        vkCmdResetQueryPool(commandBuffer, pipeStatsQueryPool, 0, 1);
-        vkCmdBeginQuery(commandBuffer, pipeStatsQueryPool, 0, 0);
+        gpuProfiler.beginFrame(commandBuffer, currentFrame, glfwGetTime() * 1000);
+        vkCmdResetQueryPool(commandBuffer, pipeStatsQueryPool, currentFrame, 1);
+        vkCmdBeginQuery(commandBuffer, pipeStatsQueryPool, currentFrame, 0);
     }
 
+    recordDrawUpdates(commandBuffer);
+
     glm::mat4 projection = MakeInfReversedZProjRH(glm::radians(70.f), float(swapChainExtent.width) / float(swapChainExtent.height), 1.f);
 
+    // without mesh shading, meshlets are culled in compute and drawn through a compacted index buffer
+    bool meshletCullPass = meshletCullEnabled && !(rtxEnabled && rtxSupported);
+
+    // the plain vertex path draws whole index ranges, so the cut only exists where meshlets are selected one by one
+    bool clusterLodPass = clusterLodEnabled && ((rtxEnabled && rtxSupported) || meshletCullPass);
+
+    bool forwardVertexPath = !(rtxEnabled && rtxSupported) && !visibilityEnabled;
+    bool depthPrepass = depthPrepassEnabled && forwardVertexPath;
+    // the depth prepass has no fragment shader to dither with, its depth would fail the EQUAL test of the other lod
+    bool lodFade = lodFadeEnabled && !depthPrepass;
+
     {
-        if (queryEnabled)
-        {
-            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2);
-        }
+        GpuScope cullScope(gpuProfiler, commandBuffer, "cull");
+
         glm::mat4 projectionT = glm::transpose(projection);
 
         DrawCullData cullData = {};
@@ -36,32 +46,114 @@ void renderApplication::recordCommandBuffer(VkCommandBuffer commandBuffer, uint3
         cullData.drawCount = drawCount;
         cullData.cullingEnabled = cullEnabled;
         cullData.lodEnabled = lodEnabled;
-        
-        vkCmdFillBuffer(commandBuffer, dccb.buffer, 0, 4, 0);
+        cullData.statisticsEnabled = queryEnabled;
+        cullData.meshletCullEnabled = meshletCullPass;
+        cullData.lodFadeEnabled = lodFade;
+        cullData.bvhEnabled = bvhCullEnabled;
+        cullData.clusterLodEnabled = clusterLodPass;
+
+        vkCmdFillBuffer(commandBuffer, bvlb.buffer, 0, sizeof(VisibleLeafHeader), 0);
+        vkCmdFillBuffer(commandBuffer, dccb.buffer, 0, sizeof(DrawCommandCount), 0);
+        vkCmdFillBuffer(commandBuffer, csb.buffer, 0, sizeof(CullStatistics), 0);
+
+        VkBufferMemoryBarrier fillBarriers[] =
+        {
+            bufferBarrier(dccb.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+            bufferBarrier(csb.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+            bufferBarrier(bvlb.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, sizeof(fillBarriers) / sizeof(fillBarriers[0]), fillBarriers, 0, 0);
+
+        if (bvhCullEnabled)
+        {
+            GpuScope bvhCullScope(gpuProfiler, commandBuffer, "bvhCull");
 
-        VkBufferMemoryBarrier fillBarrier = bufferBarrier(dccb.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, 1, &fillBarrier, 0, 0);
+            BvhCullData bvhCullData = {};
+            memcpy(bvhCullData.frustum, cullData.frustum, sizeof(cullData.frustum));
+            bvhCullData.cullingEnabled = cullEnabled;
+            bvhCullData.statisticsEnabled = queryEnabled;
+
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bvhcullPipeline);
+
+            DescriptorInfo bvhDescriptors[] = { bnb.buffer, blb.buffer, bvlb.buffer, csb.buffer };
+
+            vkCmdPushDescriptorSetWithTemplateKHR(commandBuffer, bvhcullProgram.updateTemplate, bvhcullProgram.layout, 0, bvhDescriptors);
+
+            vkCmdPushConstants(commandBuffer, bvhcullProgram.layout, bvhcullProgram.pushConstantStages, 0, sizeof(BvhCullData), &bvhCullData);
+            vkCmdDispatch(commandBuffer, drawBvhNodeCount, 1, 1);
+
+            VkBufferMemoryBarrier bvhCullBarriers[] =
+            {
+                bufferBarrier(bvlb.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT),
+                bufferBarrier(csb.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+            };
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, sizeof(bvhCullBarriers) / sizeof(bvhCullBarriers[0]), bvhCullBarriers, 0, 0);
+        }
           
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, drawcmdPipeline);
 
-        DescriptorInfo descriptors[] = { db.buffer, meshes[0].mb.buffer, dcb.buffer, dccb.buffer };
+        DescriptorInfo descriptors[] = { db.buffer, meshes[0].mb.buffer, dcb.buffer, dccb.buffer, csb.buffer, dlsb.buffer, meshes[0].lb.buffer, blb.buffer, bvlb.buffer, bob.buffer };
 
         vkCmdPushDescriptorSetWithTemplateKHR(commandBuffer, drawcmdProgram.updateTemplate, drawcmdProgram.layout, 0, descriptors);
 
         vkCmdPushConstants(commandBuffer, drawcmdProgram.layout, drawcmdProgram.pushConstantStages, 0, sizeof(DrawCullData), &cullData);
-        vkCmdDispatch(commandBuffer, getGroupCount(uint32_t(draws.size()), drawcullCS.localSizeX), 1, 1);
-
-        VkBufferMemoryBarrier cullBarrier = bufferBarrier(dcb.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
-        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, 0, 1, &cullBarrier, 0, 0);
-        if (queryEnabled)
+        if (bvhCullEnabled)
+        {
+            vkCmdDispatchIndirect(commandBuffer, bvlb.buffer, offsetof(VisibleLeafHeader, drawCullDispatch));
+        }
+        else
         {
-            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 3);
+            vkCmdDispatch(commandBuffer, getGroupCount(uint32_t(draws.size()), drawcullCS.localSizeX), 1, 1);
         }
+
+        VkBufferMemoryBarrier cullBarriers[] =
+        {
+            bufferBarrier(dcb.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT),
+            bufferBarrier(dccb.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, sizeof(cullBarriers) / sizeof(cullBarriers[0]), cullBarriers, 0, 0);
+    }
+
+    if (meshletCullPass)
+    {
+        GpuScope meshletCullScope(gpuProfiler, commandBuffer, "meshletCull");
+
+        glm::mat4 projectionT = glm::transpose(projection);
+
+        meshletCullData.frustum[0] = normalizePlane(projectionT[3] + projectionT[0]);
+        meshletCullData.frustum[1] = normalizePlane(projectionT[3] - projectionT[0]);
+        meshletCullData.frustum[2] = normalizePlane(projectionT[3] + projectionT[1]);
+        meshletCullData.frustum[3] = normalizePlane(projectionT[3] - projectionT[1]);
+        meshletCullData.frustum[4] = normalizePlane(projectionT[3] - projectionT[2]);
+        meshletCullData.frustum[5] = glm::vec4(0.f, 0.f, -1.f, drawDistance);
+        meshletCullData.indexOffset = uint32_t(meshes[0].m_indices.size());
+        meshletCullData.indexCapacity = MESHLETCULLINDEXCOUNT;
+        meshletCullData.cullingEnabled = cullEnabled;
+        meshletCullData.statisticsEnabled = queryEnabled;
+        meshletCullData.clusterLodScale = projection[1][1] * 0.5f * float(swapChainExtent.height);
+        meshletCullData.clusterLodThreshold = clusterLodThreshold;
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, meshletcullPipeline);
+
+        DescriptorInfo descriptors[] = { dcb.buffer, dccb.buffer, db.buffer, meshes[0].mlb.buffer, meshes[0].mvb.buffer, meshes[0].mtb.buffer, mcdb.buffer, mcib.buffer, csb.buffer, meshes[0].meb.buffer };
+
+        vkCmdPushDescriptorSetWithTemplateKHR(commandBuffer, meshletcullProgram.updateTemplate, meshletcullProgram.layout, 0, descriptors);
+
+        vkCmdPushConstants(commandBuffer, meshletcullProgram.layout, meshletcullProgram.pushConstantStages, 0, sizeof(MeshletCullData), &meshletCullData);
+        vkCmdDispatchIndirect(commandBuffer, dccb.buffer, offsetof(DrawCommandCount, meshletCullDispatch));
+
+        VkBufferMemoryBarrier meshletCullBarriers[] =
+        {
+            bufferBarrier(mcdb.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT),
+            bufferBarrier(mcib.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDEX_READ_BIT),
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0, 0, sizeof(meshletCullBarriers) / sizeof(meshletCullBarriers[0]), meshletCullBarriers, 0, 0);
     }
 
     VkImageMemoryBarrier renderBeginBarriers[] =
     {
         imageBarrier(colorTarget.image, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
+        imageBarrier(visibilityTarget.image, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
         imageBarrier(depthTarget.image, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT),
     };
     vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, sizeof(renderBeginBarriers) / sizeof(renderBeginBarriers[0]), renderBeginBarriers);
@@ -70,10 +162,17 @@ void renderApplication::recordCommandBuffer(VkCommandBuffer commandBuffer, uint3
     clearValues[0].color = { 0.f, 0.f, 0.f, 1.f };
     clearValues[1].depthStencil = { 0.f, 0 };
 
+    if (visibilityEnabled)
+    {
+        clearValues[0].color.uint32[0] = VISIBILITY_EMPTY;
+        clearValues[0].color.uint32[1] = VISIBILITY_EMPTY;
+    }
+
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = renderPass;
-    renderPassInfo.framebuffer = targetFB;//swapChainFramebuffers[imageIndex];
+    // after the prepass the color pass keeps its depth and only shades the fragments that passed the EQUAL test
+    renderPassInfo.renderPass = visibilityEnabled ? renderPassVisibility : depthPrepass ? renderPassEqual : renderPass;
+    renderPassInfo.framebuffer = visibilityEnabled ? visibilityFB : targetFB;//swapChainFramebuffers[imageIndex];
     renderPassInfo.renderArea.offset = { 0, 0 };
     renderPassInfo.renderArea.extent = swapChainExtent;
     renderPassInfo.clearValueCount = sizeof(clearValues) / sizeof(clearValues[0]);
@@ -93,41 +192,99 @@ void renderApplication::recordCommandBuffer(VkCommandBuffer commandBuffer, uint3
     scissor.extent = swapChainExtent;
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
     Globals globals = {};
     globals.projection = projection;
+    globals.statisticsEnabled = queryEnabled;
+    globals.screenWidth = float(swapChainExtent.width);
+    globals.screenHeight = float(swapChainExtent.height);
+    globals.clusterLodThreshold = clusterLodThreshold;
+
+    if (depthPrepass)
+    {
+        GpuScope prepassScope(gpuProfiler, commandBuffer, "prepass");
+
+        VkRenderPassBeginInfo depthPassInfo{};
+        depthPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        depthPassInfo.renderPass = renderPassDepth;
+        depthPassInfo.framebuffer = depthFB;
+        depthPassInfo.renderArea.offset = { 0, 0 };
+        depthPassInfo.renderArea.extent = swapChainExtent;
+        depthPassInfo.clearValueCount = 1;
+        depthPassInfo.pClearValues = &clearValues[1];
+
+        vkCmdBeginRenderPass(commandBuffer, &depthPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPipeline);
+
+        const Buffer& drawCommands = meshletCullPass ? mcdb : dcb;
+
+        DescriptorInfo descriptors[] = { drawCommands.buffer, db.buffer, meshes[0].pb.buffer, meshes[0].mb.buffer };
+
+        vkCmdPushDescriptorSetWithTemplateKHR(commandBuffer, depthProgram.updateTemplate, depthProgram.layout, 0, descriptors);
+
+        vkCmdBindIndexBuffer(commandBuffer, meshletCullPass ? mcib.buffer : meshes[0].ib.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+        vkCmdPushConstants(commandBuffer, depthProgram.layout, depthProgram.pushConstantStages, 0, sizeof(globals), &globals);
+        vkCmdDrawIndexedIndirectCountKHR(commandBuffer, drawCommands.buffer, offsetof(MeshDrawCommand, indirect), dccb.buffer, offsetof(DrawCommandCount, drawCommandCount), drawCommandCapacity, sizeof(MeshDrawCommand));
+
+        vkCmdEndRenderPass(commandBuffer);
+
+        VkImageMemoryBarrier prepassBarrier = imageBarrier(depthTarget.image, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &prepassBarrier);
+    }
+
+    gpuProfiler.beginScope(commandBuffer, "main");
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
     if (rtxEnabled && rtxSupported)
     {
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, rtxGraphicsPipeline);
+        VkPipeline pipeline = visibilityEnabled ? (lodFade ? rtxVisibilityFadePipeline : rtxVisibilityPipeline) : (lodFade ? rtxGraphicsFadePipeline : rtxGraphicsPipeline);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
-        DescriptorInfo descriptors[] = { dcb.buffer, db.buffer, meshes[0].mlb.buffer, meshes[0].mdb.buffer, meshes[0].vb.buffer };
+        DescriptorInfo descriptors[] = { dcb.buffer, db.buffer, meshes[0].mlb.buffer, meshes[0].mvb.buffer, meshes[0].vb.buffer, csb.buffer, meshes[0].mtb.buffer, meshes[0].pb.buffer, meshes[0].mb.buffer, meshes[0].meb.buffer };
 
         vkCmdPushDescriptorSetWithTemplateKHR(commandBuffer, rtxGraphicsProgram.updateTemplate, rtxGraphicsProgram.layout, 0, descriptors);
 
         vkCmdPushConstants(commandBuffer, rtxGraphicsProgram.layout, rtxGraphicsProgram.pushConstantStages, 0, sizeof(globals), &globals);
-        vkCmdDrawMeshTasksIndirectCountNV(commandBuffer, dcb.buffer, offsetof(MeshDrawCommand, indirectMS), dccb.buffer, 0, uint32_t(draws.size()), sizeof(MeshDrawCommand));
+        if (meshShaderEXT)
+        {
+            vkCmdDrawMeshTasksIndirectCountEXT(commandBuffer, dcb.buffer, offsetof(MeshDrawCommand, indirectMSEXT), dccb.buffer, 0, drawCommandCapacity, sizeof(MeshDrawCommand));
+        }
+        else
+        {
+            vkCmdDrawMeshTasksIndirectCountNV(commandBuffer, dcb.buffer, offsetof(MeshDrawCommand, indirectMS), dccb.buffer, 0, drawCommandCapacity, sizeof(MeshDrawCommand));
+        }
     }
     else
     {
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        VkPipeline pipeline = visibilityEnabled ? (lodFade ? visibilityFadePipeline : visibilityPipeline) : depthPrepass ? graphicsEqualPipeline : lodFade ? graphicsFadePipeline : graphicsPipeline;
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+        // meshletcull.comp writes one command per draw command, so the draw count is shared
+        const Buffer& drawCommands = meshletCullPass ? mcdb : dcb;
 
-        DescriptorInfo descriptors[] = { dcb.buffer, db.buffer, meshes[0].vb.buffer };
+        DescriptorInfo descriptors[] = { drawCommands.buffer, db.buffer, meshes[0].vb.buffer, meshes[0].pb.buffer, meshes[0].mb.buffer };
 
         vkCmdPushDescriptorSetWithTemplateKHR(commandBuffer, graphicsProgram.updateTemplate, graphicsProgram.layout, 0, descriptors);
 
         // VkBuffer vertexBuffers[] = { meshes[0].vb.buffer };
         VkDeviceSize dummyOffset = 0;
         //vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, &dummyOffset);
-        vkCmdBindIndexBuffer(commandBuffer, meshes[0].ib.buffer, dummyOffset, VK_INDEX_TYPE_UINT32);
+        vkCmdBindIndexBuffer(commandBuffer, meshletCullPass ? mcib.buffer : meshes[0].ib.buffer, dummyOffset, VK_INDEX_TYPE_UINT32);
 
         vkCmdPushConstants(commandBuffer, graphicsProgram.layout, graphicsProgram.pushConstantStages, 0, sizeof(globals), &globals);
-        vkCmdDrawIndexedIndirectCountKHR(commandBuffer, dcb.buffer, offsetof(MeshDrawCommand, indirect), dccb.buffer, 0, uint32_t(draws.size()), sizeof(MeshDrawCommand));
+        vkCmdDrawIndexedIndirectCountKHR(commandBuffer, drawCommands.buffer, offsetof(MeshDrawCommand, indirect), dccb.buffer, offsetof(DrawCommandCount, drawCommandCount), drawCommandCapacity, sizeof(MeshDrawCommand));
     }
 
     vkCmdEndRenderPass(commandBuffer);
 
+    gpuProfiler.endScope(commandBuffer);
+
+    gpuProfiler.beginScope(commandBuffer, "pyramid");
+
     VkImageMemoryBarrier depthReadBarriers[] =
     {
         imageBarrier(depthTarget.image, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT),
@@ -162,6 +319,10 @@ void renderApplication::recordCommandBuffer(VkCommandBuffer commandBuffer, uint3
 
     vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &depthWriteBarrier);
 
+    gpuProfiler.endScope(commandBuffer);
+
+    gpuProfiler.beginScope(commandBuffer, "late");
+
     VkRenderPassBeginInfo renderPassLateInfo{};
     renderPassLateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     renderPassLateInfo.renderPass = renderPassLate;
@@ -173,12 +334,46 @@ void renderApplication::recordCommandBuffer(VkCommandBuffer commandBuffer, uint3
 
     vkCmdEndRenderPass(commandBuffer);
 
+    gpuProfiler.endScope(commandBuffer);
+
+    if (visibilityEnabled)
+    {
+        GpuScope resolveScope(gpuProfiler, commandBuffer, "resolve");
+
+        VkImageMemoryBarrier resolveBarriers[] =
+        {
+            imageBarrier(visibilityTarget.image, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL),
+            imageBarrier(resolveTarget.image, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL),
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, sizeof(resolveBarriers) / sizeof(resolveBarriers[0]), resolveBarriers);
+
+        visibilityResolveData.projection = projection;
+        visibilityResolveData.screenWidth = float(swapChainExtent.width);
+        visibilityResolveData.screenHeight = float(swapChainExtent.height);
+        visibilityResolveData.meshShading = rtxEnabled && rtxSupported;
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, visresolvePipeline);
+
+        // the vertex path ids index whichever index buffer the main pass was drawn from
+        DescriptorInfo descriptors[] = { { visibilityTarget.imageView, VK_IMAGE_LAYOUT_GENERAL }, { resolveTarget.imageView, VK_IMAGE_LAYOUT_GENERAL }, db.buffer,
+            meshes[0].mlb.buffer, meshes[0].mvb.buffer, meshes[0].mtb.buffer, meshletCullPass ? mcib.buffer : meshes[0].ib.buffer, meshes[0].vb.buffer, meshes[0].pb.buffer, meshes[0].mb.buffer };
+
+        vkCmdPushDescriptorSetWithTemplateKHR(commandBuffer, visresolveProgram.updateTemplate, visresolveProgram.layout, 0, descriptors);
+
+        vkCmdPushConstants(commandBuffer, visresolveProgram.layout, visresolveProgram.pushConstantStages, 0, sizeof(VisibilityResolveData), &visibilityResolveData);
+        vkCmdDispatch(commandBuffer, getGroupCount(swapChainExtent.width, visresolveCS.localSizeX), getGroupCount(swapChainExtent.height, visresolveCS.localSizeY), 1);
+    }
+
+    gpuProfiler.beginScope(commandBuffer, "copy");
+
     VkImageMemoryBarrier copyBarriers[] =
     {
-        imageBarrier(colorTarget.image, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL),
+        visibilityEnabled
+            ? imageBarrier(resolveTarget.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+            : imageBarrier(colorTarget.image, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL),
         imageBarrier(swapChainImages[imageIndex], 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
     };
-    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, sizeof(copyBarriers) / sizeof(copyBarriers[0]), copyBarriers);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, sizeof(copyBarriers) / sizeof(copyBarriers[0]), copyBarriers);
 
     if (debugPyramid)
     {
@@ -195,6 +390,19 @@ void renderApplication::recordCommandBuffer(VkCommandBuffer commandBuffer, uint3
 
         vkCmdBlitImage(commandBuffer, depthPyramid.image, VK_IMAGE_LAYOUT_GENERAL, swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blitRegion, VK_FILTER_NEAREST);
     }
+    else if (visibilityEnabled)
+    {
+        // a blit rather than a copy swizzles RGBA8 into the swapchain format
+        VkImageBlit blitRegion = {};
+        blitRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blitRegion.srcSubresource.layerCount = 1;
+        blitRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blitRegion.dstSubresource.layerCount = 1;
+        blitRegion.srcOffsets[1] = { (int32_t)swapChainExtent.width, (int32_t)swapChainExtent.height, 1 };
+        blitRegion.dstOffsets[1] = { (int32_t)swapChainExtent.width, (int32_t)swapChainExtent.height, 1 };
+
+        vkCmdBlitImage(commandBuffer, resolveTarget.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blitRegion, VK_FILTER_NEAREST);
+    }
     else
     {
         VkImageCopy copyRegion = {};
@@ -210,66 +418,167 @@ void renderApplication::recordCommandBuffer(VkCommandBuffer commandBuffer, uint3
     VkImageMemoryBarrier presentBarrier = imageBarrier(swapChainImages[imageIndex], VK_ACCESS_TRANSFER_WRITE_BIT, 0, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
     vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &presentBarrier);
 
+    gpuProfiler.endScope(commandBuffer);
+
     if (queryEnabled)
     {
-        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 1);
-        vkCmdEndQuery(commandBuffer, pipeStatsQueryPool, 0);
+        VkBufferMemoryBarrier statisticsReadBarrier = bufferBarrier(csb.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 1, &statisticsReadBarrier, 0, 0);
+
+        VkBufferCopy statisticsRegion = { 0, VkDeviceSize(sizeof(CullStatistics) * currentFrame), VkDeviceSize(sizeof(CullStatistics)) };
+        vkCmdCopyBuffer(commandBuffer, csb.buffer, csrb.buffer, 1, &statisticsRegion);
+
+        VkBufferMemoryBarrier statisticsHostBarrier = bufferBarrier(csrb.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, 0, 1, &statisticsHostBarrier, 0, 0);
+
+        gpuProfiler.endFrame(commandBuffer);
+        vkCmdEndQuery(commandBuffer, pipeStatsQueryPool, currentFrame);
     }
 
+    queryPending[currentFrame] = queryEnabled;
+    queryDepthPrepass[currentFrame] = forwardVertexPath ? int(depthPrepass) : -1;
+
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to record command buffer!");
     }
 }
 
 
-void renderApplication::drawFrame() {
-    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+void renderApplication::readQueryResults(uint32_t frameIndex)
+{
+    gpuProfiler.collect(device, frameIndex, profileTrace);
 
-    uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    if (!queryPending[frameIndex])
+    {
+        return;
+    }
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || !targetFB) {
-        recreateSwapChain();
+    // one value per enabled statistic followed by the availability word
+    uint64_t pipeStatsAvailability[PIPESTATSMAXCOUNT + 1] = {};
+    VkDeviceSize pipeStatsStride = sizeof(uint64_t) * (pipeStatsCount + 1);
+    VkResult result = vkGetQueryPoolResults(device, pipeStatsQueryPool, frameIndex, 1, pipeStatsStride, pipeStatsAvailability, pipeStatsStride, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
 
-        if (colorTarget.image)
-        {
-            destroyImage(colorTarget, device);
-        }
-        if (depthTarget.image)
-        {
-            destroyImage(depthTarget, device);
-        }
-        if (targetFB)
-        {
-            vkDestroyFramebuffer(device, targetFB, 0);
-        }
+    if (result != VK_SUCCESS || !pipeStatsAvailability[pipeStatsCount])
+    {
+        return;
+    }
 
-        if (depthPyramid.image)
+    uint32_t statisticIndex = 0;
+    for (const PipelineStatistic& statistic : pipelineStatistics)
+    {
+        if (pipeStatsFlags & statistic.flag)
         {
-            for (uint32_t i = 0; i < depthPyramidLevels; ++i)
+            pipeStatsQueryResults[statisticIndex] = pipeStatsAvailability[statisticIndex];
+
+            if (statistic.flag == VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT)
+            {
+                triangleCount = uint32_t(pipeStatsAvailability[statisticIndex]);
+            }
+            if (statistic.flag == VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT && queryDepthPrepass[frameIndex] >= 0)
             {
-                vkDestroyImageView(device, depthPyramidMips[i], 0);
+                fragmentInvocations[queryDepthPrepass[frameIndex]] = pipeStatsAvailability[statisticIndex];
             }
-            destroyImage(depthPyramid, device);
+            statisticIndex++;
         }
+    }
 
-        VkPhysicalDeviceMemoryProperties memProperties;
-        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-
-        createImage(colorTarget, device, memProperties, swapChainExtent.width, swapChainExtent.height, 1, VK_FORMAT_B8G8R8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
-        createImage(depthTarget, device, memProperties, swapChainExtent.width, swapChainExtent.height, 1, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+    memcpy(&cullStatistics, static_cast<const char*>(csrb.data) + sizeof(CullStatistics) * frameIndex, sizeof(CullStatistics));
 
-        targetFB = createFramebuffer(device, renderPass, colorTarget.imageView, depthTarget.imageView, swapChainExtent.width, swapChainExtent.height);
+    queryPending[frameIndex] = false;
+}
 
-        depthPyramidLevels = getImageMipLevels(swapChainExtent.width / 2, swapChainExtent.height / 2);
+void renderApplication::destroyRenderTargets()
+{
+    if (colorTarget.image)
+    {
+        destroyImage(colorTarget, device);
+    }
+    if (depthTarget.image)
+    {
+        destroyImage(depthTarget, device);
+    }
+    if (targetFB)
+    {
+        vkDestroyFramebuffer(device, targetFB, 0);
+    }
 
-        createImage(depthPyramid, device, memProperties, swapChainExtent.width / 2, swapChainExtent.height / 2, depthPyramidLevels, VK_FORMAT_R32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    if (visibilityTarget.image)
+    {
+        destroyImage(visibilityTarget, device);
+    }
+    if (resolveTarget.image)
+    {
+        destroyImage(resolveTarget, device);
+    }
+    if (visibilityFB)
+    {
+        vkDestroyFramebuffer(device, visibilityFB, 0);
+    }
+    if (depthFB)
+    {
+        vkDestroyFramebuffer(device, depthFB, 0);
+    }
 
+    if (depthPyramid.image)
+    {
         for (uint32_t i = 0; i < depthPyramidLevels; ++i)
         {
-            depthPyramidMips[i] = createImageView(device, depthPyramid.image, VK_FORMAT_R32_SFLOAT, i, 1);
-            assert(depthPyramidMips[i]);
+            vkDestroyImageView(device, depthPyramidMips[i], 0);
         }
+        destroyImage(depthPyramid, device);
+    }
+}
+
+void renderApplication::createRenderTargets()
+{
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    createImage(colorTarget, device, memProperties, swapChainExtent.width, swapChainExtent.height, 1, VK_FORMAT_B8G8R8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    createImage(depthTarget, device, memProperties, swapChainExtent.width, swapChainExtent.height, 1, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+    targetFB = createFramebuffer(device, renderPass, colorTarget.imageView, depthTarget.imageView, swapChainExtent.width, swapChainExtent.height);
+
+    // B8G8R8A8 storage support is optional, so the resolve writes RGBA8 and the copy pass blits it
+    createImage(visibilityTarget, device, memProperties, swapChainExtent.width, swapChainExtent.height, 1, VK_FORMAT_R32G32_UINT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    createImage(resolveTarget, device, memProperties, swapChainExtent.width, swapChainExtent.height, 1, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+    visibilityFB = createFramebuffer(device, renderPassVisibility, visibilityTarget.imageView, depthTarget.imageView, swapChainExtent.width, swapChainExtent.height);
+
+    depthFB = createFramebuffer(device, renderPassDepth, VK_NULL_HANDLE, depthTarget.imageView, swapChainExtent.width, swapChainExtent.height);
+
+    depthPyramidLevels = getImageMipLevels(swapChainExtent.width / 2, swapChainExtent.height / 2);
+
+    createImage(depthPyramid, device, memProperties, swapChainExtent.width / 2, swapChainExtent.height / 2, depthPyramidLevels, VK_FORMAT_R32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+    for (uint32_t i = 0; i < depthPyramidLevels; ++i)
+    {
+        depthPyramidMips[i] = createImageView(device, depthPyramid.image, VK_FORMAT_R32_SFLOAT, i, 1);
+        assert(depthPyramidMips[i]);
+    }
+}
+
+void renderApplication::drawFrame() {
+    {
+        CpuScope waitScope(profileTrace, "waitForFence");
+        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    }
+
+    // the frame that last used this slot has retired, so its queries can be read back without stalling
+    readQueryResults(currentFrame);
+
+    uint32_t imageIndex;
+    VkResult result;
+    {
+        CpuScope acquireScope(profileTrace, "acquire");
+        result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    }
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || !targetFB) {
+        recreateSwapChain();
+
+        destroyRenderTargets();
+        createRenderTargets();
         return;
     }
     else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
@@ -278,8 +587,15 @@ void renderApplication::drawFrame() {
 
     vkResetFences(device, 1, &inFlightFences[currentFrame]);
 
-    vkResetCommandBuffer(commandBuffers[currentFrame], /*VkCommandBufferResetFlagBits*/ 0);
-    recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+    {
+        CpuScope recordScope(profileTrace, "record");
+        {
+            CpuScope updateScope(profileTrace, "updateDraws");
+            updateDraws();
+        }
+        vkResetCommandBuffer(commandBuffers[currentFrame], /*VkCommandBufferResetFlagBits*/ 0);
+        recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+    }
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -313,7 +629,10 @@ void renderApplication::drawFrame() {
 
     presentInfo.pImageIndices = &imageIndex;
 
-    result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    {
+        CpuScope presentScope(profileTrace, "present");
+        result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    }
 
     currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 
@@ -322,62 +641,11 @@ void renderApplication::drawFrame() {
 
         recreateSwapChain();
 
-        if (colorTarget.image)
-        {
-            destroyImage(colorTarget, device);
-        }
-        if (depthTarget.image)
-        {
-            destroyImage(depthTarget, device);
-        }
-        if (targetFB)
-        {
-            vkDestroyFramebuffer(device, targetFB, 0);
-        }
-
-        if (depthPyramid.image)
-        {
-            for (uint32_t i = 0; i < depthPyramidLevels; ++i)
-            {
-                vkDestroyImageView(device, depthPyramidMips[i], 0);
-            }
-            destroyImage(depthPyramid, device);
-        }
-
-        VkPhysicalDeviceMemoryProperties memProperties;
-        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-
-        createImage(colorTarget, device, memProperties, swapChainExtent.width, swapChainExtent.height, 1, VK_FORMAT_B8G8R8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
-        createImage(depthTarget, device, memProperties, swapChainExtent.width, swapChainExtent.height, 1, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
-
-        targetFB = createFramebuffer(device, renderPass, colorTarget.imageView, depthTarget.imageView, swapChainExtent.width, swapChainExtent.height);
-
-        depthPyramidLevels = getImageMipLevels(swapChainExtent.width / 2, swapChainExtent.height / 2);
-
-        createImage(depthPyramid, device, memProperties, swapChainExtent.width / 2, swapChainExtent.height / 2, depthPyramidLevels, VK_FORMAT_R32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
-
-        for (uint32_t i = 0; i < depthPyramidLevels; ++i)
-        {
-            depthPyramidMips[i] = createImageView(device, depthPyramid.image, VK_FORMAT_R32_SFLOAT, i, 1);
-            assert(depthPyramidMips[i]);
-        }
+        destroyRenderTargets();
+        createRenderTargets();
         return;
     }
     else if (result != VK_SUCCESS) {
         throw std::runtime_error("failed to present swap chain image!");
     }
-
-    if (queryEnabled)
-    {
-        vkGetQueryPoolResults(device, queryPool, 0,
-            sizeof(queryResults) / sizeof(queryResults[0]), sizeof(queryResults), queryResults, sizeof(queryResults[0]), VK_QUERY_RESULT_WAIT_BIT | VK_QUERY_RESULT_64_BIT);
-        vkGetQueryPoolResults(device, pipeStatsQueryPool, 0,
-            1, sizeof(pipeStatsQueryResults), pipeStatsQueryResults, sizeof(pipeStatsQueryResults[0]), VK_QUERY_RESULT_WAIT_BIT);
-
-        triangleCount = pipeStatsQueryResults[0];
-        frameGPUBegin = double(queryResults[0]) * timestampPeriod * 1e-6;
-        frameGPUEnd = double(queryResults[1]) * timestampPeriod * 1e-6;
-        frameGPUAvg = frameGPUAvg * 0.95 + (frameGPUEnd - frameGPUBegin) * 0.05;
-        cullGPUTime = double(queryResults[3] - queryResults[2]) * timestampPeriod * 1e-6;
-    }
 }
\ No newline at end of file
@@ -0,0 +1,545 @@
+#include "app.h"
+#include "overdraw_analyzer.h"
+#include "cluster_dag.h"
+
+#include <chrono>
+
+static void writeStatistics(std::ofstream& file, const char* name, const RollingStatistics& statistics)
+{
+    char line[256];
+    snprintf(line, sizeof(line), "\"%s\": { \"avg\": %.4f, \"min\": %.4f, \"max\": %.4f, \"samples\": %u }",
+        name, statistics.average(), statistics.minimum(), statistics.maximum(), statistics.sampleCount);
+    file << line;
+}
+
+void renderApplication::writeBenchmarkReport(const char* path)
+{
+    std::ofstream file(path);
+
+    if (!file.is_open())
+    {
+        throw std::runtime_error("failed to open benchmark report file!");
+    }
+
+    file << "{\n";
+
+    file << "  \"settings\": { ";
+    file << "\"drawCount\": " << drawCount;
+    file << ", \"meshShading\": " << ((rtxEnabled && rtxSupported) ? "true" : "false");
+    file << ", \"meshShaderPath\": \"" << (rtxSupported ? (meshShaderEXT ? "EXT" : "NV") : "none") << "\"";
+    file << ", \"culling\": " << (cullEnabled ? "true" : "false");
+    file << ", \"lod\": " << (lodEnabled ? "true" : "false");
+    file << ", \"meshletCull\": " << (meshletCullEnabled ? "true" : "false");
+    file << ", \"visibilityBuffer\": " << (visibilityEnabled ? "true" : "false");
+    file << ", \"depthPrepass\": " << (depthPrepassEnabled ? "true" : "false");
+    file << ", \"lodFade\": " << (lodFadeEnabled ? "true" : "false");
+    file << ", \"bvhCull\": " << (bvhCullEnabled ? "true" : "false");
+    file << ", \"clusterLod\": " << (clusterLodEnabled ? "true" : "false");
+    file << ", \"width\": " << swapChainExtent.width;
+    file << ", \"height\": " << swapChainExtent.height;
+    file << " },\n";
+
+    file << "  \"cpuFrameMs\": " << frameCPUAvg << ",\n";
+
+    // gpu scope timings in ms over the last STATISTICSWINDOW collected frames
+    file << "  \"gpuScopesMs\": {";
+    bool first = true;
+    for (const auto& scope : gpuProfiler.getAllStatistics())
+    {
+        file << (first ? "\n    " : ",\n    ");
+        writeStatistics(file, scope.first.c_str(), scope.second);
+        first = false;
+    }
+    file << "\n  },\n";
+
+    file << "  \"pipelineStatistics\": {";
+    uint32_t statisticIndex = 0;
+    first = true;
+    for (const PipelineStatistic& statistic : pipelineStatistics)
+    {
+        if (pipeStatsFlags & statistic.flag)
+        {
+            file << (first ? "\n    " : ",\n    ");
+            file << "\"" << statistic.name << "\": " << pipeStatsQueryResults[statisticIndex++];
+            first = false;
+        }
+    }
+    file << "\n  },\n";
+
+    file << "  \"cullStatistics\": {\n";
+    file << "    \"drawsTested\": " << cullStatistics.drawsTested << ",\n";
+    file << "    \"drawsFrustumRejected\": " << cullStatistics.drawsFrustumRejected << ",\n";
+    file << "    \"drawsOcclusionRejected\": " << cullStatistics.drawsOcclusionRejected << ",\n";
+    file << "    \"drawsVisible\": " << cullStatistics.drawsVisible << ",\n";
+    file << "    \"lodHistogram\": [";
+    for (uint32_t i = 0; i < MESH_MAX_LODS; ++i)
+    {
+        file << (i ? ", " : "") << cullStatistics.lodHistogram[i];
+    }
+    file << "],\n";
+    file << "    \"meshletsTested\": " << cullStatistics.meshletsTested << ",\n";
+    file << "    \"meshletsConeRejected\": " << cullStatistics.meshletsConeRejected << ",\n";
+    file << "    \"meshletsFrustumRejected\": " << cullStatistics.meshletsFrustumRejected << ",\n";
+    file << "    \"trianglesTested\": " << cullStatistics.trianglesTested << ",\n";
+    file << "    \"trianglesRejected\": " << cullStatistics.trianglesRejected << ",\n";
+    file << "    \"drawsLodFading\": " << cullStatistics.drawsLodFading << ",\n";
+    file << "    \"nodesTested\": " << cullStatistics.nodesTested << ",\n";
+    file << "    \"nodesRejected\": " << cullStatistics.nodesRejected << ",\n";
+    file << "    \"leavesTested\": " << cullStatistics.leavesTested << ",\n";
+    file << "    \"leavesRejected\": " << cullStatistics.leavesRejected << ",\n";
+    file << "    \"meshletsLodRejected\": " << cullStatistics.meshletsLodRejected << "\n";
+    file << "  },\n";
+
+    // share of the triangles reaching the mesh shaders that the per triangle cull kept away from the rasterizer
+    double rasterizedReduction = cullStatistics.trianglesTested ? double(cullStatistics.trianglesRejected) / double(cullStatistics.trianglesTested) : 0.0;
+    file << "  \"rasterizedPrimitiveReduction\": " << rasterizedReduction << ",\n";
+
+    // the last sampled frame of each mode, toggle Z with queries on to fill in both
+    double fragmentReduction = fragmentInvocations[0] && fragmentInvocations[1] ? 1.0 - double(fragmentInvocations[1]) / double(fragmentInvocations[0]) : 0.0;
+    file << "  \"depthPrepassComparison\": { ";
+    file << "\"fragmentShaderInvocationsWithout\": " << fragmentInvocations[0];
+    file << ", \"fragmentShaderInvocationsWith\": " << fragmentInvocations[1];
+    file << ", \"reduction\": " << fragmentReduction;
+    file << " }\n";
+
+    file << "}\n";
+
+    std::cout << "benchmark report written to " << path << std::endl;
+}
+
+static std::string jsonEscape(const std::string& text)
+{
+    std::string result;
+    for (char c : text)
+    {
+        if (c == '\\' || c == '"')
+        {
+            result += '\\';
+        }
+        result += c;
+    }
+    return result;
+}
+
+static std::vector<float> decodeInstancePositions(const Mesh& mesh, const MeshInstance& instance)
+{
+    std::vector<float> positions(instance.vertexCount * 3);
+    for (uint32_t v = 0; v < instance.vertexCount; ++v)
+    {
+        glm::vec3 position = decodeVertexPosition(mesh.m_vertices[instance.vertexOffset + v], instance);
+        positions[v * 3 + 0] = position.x;
+        positions[v * 3 + 1] = position.y;
+        positions[v * 3 + 2] = position.z;
+    }
+    return positions;
+}
+
+void renderApplication::writeAssetReport(const char* path)
+{
+    // the report also logs what the overdraw pass changed
+    loadMeshes(true);
+
+    std::ofstream file(path);
+
+    if (!file.is_open())
+    {
+        throw std::runtime_error("failed to open asset report file!");
+    }
+
+    file << "{\n";
+    file << "  \"meshes\": [";
+
+    bool firstInstance = true;
+    for (const Mesh& mesh : meshes)
+    {
+        for (size_t i = 0; i < mesh.m_instances.size(); ++i)
+        {
+            const MeshInstance& instance = mesh.m_instances[i];
+
+            // overdraw is measured on the positions the gpu sees
+            std::vector<float> positions = decodeInstancePositions(mesh, instance);
+
+            file << (firstInstance ? "\n    { " : ",\n    { ");
+            file << "\"name\": \"" << jsonEscape(mesh.m_instanceNames[i]) << "\"";
+            file << ", \"vertices\": " << instance.vertexCount;
+            file << ", \"vertexBytes\": " << sizeof(Vertex);
+            file << ", \"clusterDagMeshlets\": " << instance.clusterCount;
+            file << ", \"lods\": [";
+            firstInstance = false;
+
+            for (uint32_t l = 0; l < instance.lodCount; ++l)
+            {
+                const MeshLod& lod = mesh.m_lods[instance.lodOffset + l];
+                const uint32_t* indices = &mesh.m_indices[lod.indexOffset];
+
+                meshopt_VertexCacheStatistics vcs = meshopt_analyzeVertexCache(indices, lod.indexCount, instance.vertexCount, 16, 0, 0);
+                meshopt_VertexFetchStatistics vfs = meshopt_analyzeVertexFetch(indices, lod.indexCount, instance.vertexCount, sizeof(Vertex));
+                meshopt_OverdrawStatistics os = analyzeOverdrawParallel(indices, lod.indexCount, positions.data(), instance.vertexCount, sizeof(float) * 3);
+
+                // fill against the 64 vertex / MESHLETTRICOUNT triangle limits of appendMeshlets
+                // a meshlet is backface culled for the views inside its cone, (1 - cutoff) / 2 of all directions
+                size_t meshletVertices = 0;
+                size_t meshletTriangles = 0;
+                double coneCullTriangles = 0;
+                for (uint32_t m = lod.meshletOffset; m < lod.meshletOffset + lod.meshletCount; ++m)
+                {
+                    const Meshlet& meshlet = mesh.m_meshlets[m];
+                    float cutoff = meshlet.cone_cutoff / 127.f;
+
+                    meshletVertices += meshlet.vertexCount;
+                    meshletTriangles += meshlet.triangleCount;
+                    coneCullTriangles += std::max(0.f, std::min(1.f, (1.f - cutoff) * 0.5f)) * meshlet.triangleCount;
+                }
+
+                double meshletCount = std::max(double(lod.meshletCount), 1.0);
+
+                char line[512];
+                snprintf(line, sizeof(line), "{ \"triangles\": %u, \"error\": %g, \"acmr\": %.4f, \"atvr\": %.4f, \"overfetch\": %.4f, \"overdraw\": %.4f, "
+                    "\"meshlets\": %u, \"meshletVertexFill\": %.4f, \"meshletTriangleFill\": %.4f, \"coneCullPotential\": %.4f }",
+                    lod.indexCount / 3, lod.error, vcs.acmr, vcs.atvr, vfs.overfetch, os.overdraw,
+                    lod.meshletCount, double(meshletVertices) / (meshletCount * 64), double(meshletTriangles) / (meshletCount * MESHLETTRICOUNT),
+                    meshletTriangles ? coneCullTriangles / double(meshletTriangles) : 0.0);
+
+                file << (l ? ",\n      " : "\n      ") << line;
+            }
+
+            file << "\n    ] }";
+        }
+    }
+
+    file << "\n  ]\n";
+    file << "}\n";
+
+    std::cout << "asset report written to " << path << std::endl;
+}
+
+void renderApplication::runOverdrawBenchmark()
+{
+    const char* paths[] = { "..\\kitten.obj", "..\\extern\\common-3d-test-models\\data\\xyzrgb_dragon.obj" };
+    const int iterations = 5;
+
+    for (const char* path : paths)
+    {
+        Mesh mesh;
+        mesh.loadMesh(path, MeshBuildSettings());
+
+        const MeshInstance& instance = mesh.m_instances[0];
+        const MeshLod& lod = mesh.m_lods[instance.lodOffset];
+        const uint32_t* indices = &mesh.m_indices[lod.indexOffset];
+
+        std::vector<float> positions = decodeInstancePositions(mesh, instance);
+
+        meshopt_OverdrawStatistics reference = {};
+        meshopt_OverdrawStatistics parallel = {};
+        double referenceMs = 0;
+        double parallelMs = 0;
+
+        // best of a few runs, the first parallel run also pays for spinning up the thread pool
+        for (int i = 0; i < iterations; ++i)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            reference = meshopt_analyzeOverdraw(indices, lod.indexCount, positions.data(), instance.vertexCount, sizeof(float) * 3);
+            auto middle = std::chrono::high_resolution_clock::now();
+            parallel = analyzeOverdrawParallel(indices, lod.indexCount, positions.data(), instance.vertexCount, sizeof(float) * 3);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            double referenceTime = std::chrono::duration<double, std::milli>(middle - start).count();
+            double parallelTime = std::chrono::duration<double, std::milli>(end - middle).count();
+
+            referenceMs = i ? std::min(referenceMs, referenceTime) : referenceTime;
+            parallelMs = i ? std::min(parallelMs, parallelTime) : parallelTime;
+        }
+
+        if (reference.pixels_covered != parallel.pixels_covered || reference.pixels_shaded != parallel.pixels_shaded || reference.overdraw != parallel.overdraw)
+        {
+            throw std::runtime_error("parallel overdraw analyzer diverged from meshopt_analyzeOverdraw!");
+        }
+
+        double triangles = double(lod.indexCount / 3);
+        printf("%s: %u triangles, overdraw %.4f, meshopt %.2f ms (%.2f Mtri/s), parallel %.2f ms (%.2f Mtri/s), %.2fx\n",
+            path, lod.indexCount / 3, parallel.overdraw,
+            referenceMs, triangles / (referenceMs * 1e3), parallelMs, triangles / (parallelMs * 1e3), referenceMs / parallelMs);
+    }
+}
+
+void renderApplication::runBvhRefitBenchmark()
+{
+    loadMeshes();
+    generateDraws();
+
+    const std::vector<MeshInstance>& instances = meshes[0].m_instances;
+
+    auto buildStart = std::chrono::high_resolution_clock::now();
+    drawBvh.build(draws, instances);
+    auto buildEnd = std::chrono::high_resolution_clock::now();
+
+    printf("%zu draws, %zu leaves, %zu nodes: build %.2f ms\n", draws.size(), drawBvh.leaves.size(), drawBvh.nodes.size(),
+        std::chrono::duration<double, std::milli>(buildEnd - buildStart).count());
+
+    const float fractions[] = { 0.01f, 0.1f, 1.f };
+    const int iterations = 10;
+
+    for (float fraction : fractions)
+    {
+        // every fraction starts from the same tree and the same draw positions
+        std::vector<MeshDraw> initialDraws = draws;
+        DrawBvh bvh = drawBvh;
+
+        selectDynamicDraws(fraction);
+
+        std::vector<uint32_t> dirtyLeaves;
+        std::vector<uint32_t> dirtyNodes;
+        double refitMs = 0;
+
+        for (int i = 0; i < iterations; ++i)
+        {
+            moveDynamicDraws(1.f / 60.f);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            bvh.refit(draws, instances, dynamicDraws, dirtyLeaves, dirtyNodes);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            double time = std::chrono::duration<double, std::milli>(end - start).count();
+            refitMs = i ? std::min(refitMs, time) : time;
+        }
+
+        printf("%5.1f%% dynamic: %zu draws, refit %.3f ms (%.1f M draws/s), %zu leaves and %zu nodes refit, quality %.3f after %d frames\n",
+            fraction * 100.f, dynamicDraws.size(), refitMs, double(dynamicDraws.size()) / (refitMs * 1e3),
+            dirtyLeaves.size(), dirtyNodes.size(), bvh.quality(), iterations);
+
+        // the ranges drawUpdates stages for the moved draws, dynamic draws are selected in ascending order
+        std::vector<DirtyRange> uploadRanges;
+        coalesceDirtyRanges(dynamicDraws, uint32_t(BUFFER_UPDATE_MERGE_GAP / sizeof(MeshDraw)), uploadRanges);
+
+        size_t uploadDraws = 0;
+        for (const DirtyRange& range : uploadRanges)
+        {
+            uploadDraws += range.count;
+        }
+
+        printf("        draw upload: %zu ranges, %.2f of %.2f MB\n", uploadRanges.size(),
+            double(uploadDraws * sizeof(MeshDraw)) / (1024 * 1024), double(draws.size() * sizeof(MeshDraw)) / (1024 * 1024));
+
+        draws = initialDraws;
+    }
+}
+
+static bool sameBounds(const DagBounds& a, const DagBounds& b)
+{
+    return a.center == b.center && a.radius == b.radius && a.error == b.error;
+}
+
+static bool sameClusterDag(const ClusterDag& a, const ClusterDag& b)
+{
+    if (a.clusters.size() != b.clusters.size() || a.groups.size() != b.groups.size() || a.levelCount != b.levelCount)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.clusters.size(); ++i)
+    {
+        const DagCluster& ca = a.clusters[i];
+        const DagCluster& cb = b.clusters[i];
+
+        if (ca.vertices != cb.vertices || ca.triangles != cb.triangles || ca.level != cb.level || ca.group != cb.group || ca.sourceGroup != cb.sourceGroup
+            || !sameBounds(ca.self, cb.self) || !sameBounds(ca.parent, cb.parent))
+        {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < a.groups.size(); ++i)
+    {
+        if (a.groups[i].children != b.groups[i].children || !sameBounds(a.groups[i].bounds, b.groups[i].bounds))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void renderApplication::runClusterDagVerify()
+{
+    const char* paths[] = { "..\\kitten.obj", "..\\extern\\common-3d-test-models\\data\\xyzrgb_dragon.obj" };
+
+    // the pixel threshold of the renderer at 1080p, in error per unit of distance
+    const float threshold = 1.f / (1.f / tanf(glm::radians(70.f) * 0.5f) * 0.5f * 1080.f);
+
+    bool failed = false;
+
+    for (const char* path : paths)
+    {
+        // the dag loadMesh built for the renderer, with the positions it was built from
+        MeshBuildSettings settings;
+        settings.keepClusterDag = true;
+
+        Mesh mesh;
+        mesh.loadMesh(path, settings);
+
+        const MeshInstance& instance = mesh.m_instances[0];
+        const MeshLod& lod = mesh.m_lods[instance.lodOffset];
+        const uint32_t* indices = &mesh.m_indices[lod.indexOffset];
+
+        const ClusterDag& dag = mesh.m_clusterDags[0].dag;
+        const std::vector<float>& positions = mesh.m_clusterDags[0].positions;
+
+        // rebuilt from the same input, it has to match the dag loadMesh kept
+        ClusterDag repeat;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        buildClusterDag(repeat, indices, lod.indexCount, positions.data(), instance.vertexCount, sizeof(float) * 3, ClusterDagSettings());
+        auto end = std::chrono::high_resolution_clock::now();
+
+        bool deterministic = sameClusterDag(dag, repeat);
+        std::string failure = verifyClusterDag(dag, indices, lod.indexCount, positions.data(), instance.vertexCount, sizeof(float) * 3);
+
+        printf("%s: %zu meshlets in %u levels, %zu groups, build %.2f ms; %s, %s\n", path, dag.clusters.size(), dag.levelCount, dag.groups.size(),
+            std::chrono::duration<double, std::milli>(end - start).count(), deterministic ? "deterministic" : "NOT deterministic", failure.empty() ? "crack-free cuts" : failure.c_str());
+
+        // triangles of the cut for a viewer further and further away along z
+        std::vector<uint32_t> cut;
+
+        for (float distance : { 2.f, 8.f, 32.f, 128.f })
+        {
+            selectDagCut(dag, instance.center + glm::vec3(0.f, 0.f, distance * instance.radius), threshold, cut);
+
+            size_t triangles = 0;
+            for (uint32_t c : cut)
+            {
+                triangles += dag.clusters[c].triangles.size() / 3;
+            }
+
+            printf("    %5.0f radii: %zu meshlets, %zu of %u triangles\n", distance, cut.size(), triangles, lod.indexCount / 3);
+        }
+
+        failed = failed || !deterministic || !failure.empty();
+    }
+
+    if (failed)
+    {
+        throw std::runtime_error("cluster dag verification failed");
+    }
+}
+
+void renderApplication::runMeshletBenchmark()
+{
+    const char* paths[] = { "..\\kitten.obj", "..\\extern\\common-3d-test-models\\data\\xyzrgb_dragon.obj" };
+    const int iterations = 3;
+
+    struct Mode
+    {
+        const char* name;
+        MeshletStrategy strategy;
+        float coneWeight;
+        size_t partitionTriangles;
+    };
+
+    // the parallel modes split even kitten into a few partitions, their meshlet counts are compared with the serial mode above them
+    const Mode modes[] = {
+        { "scan", MESHLET_STRATEGY_SCAN, 0.f, 0 },
+        { "compact", MESHLET_STRATEGY_COMPACT, 0.f, 0 },
+        { "compact/p", MESHLET_STRATEGY_COMPACT, 0.f, 8192 },
+        { "cull 0.25", MESHLET_STRATEGY_CULL, 0.25f, 0 },
+        { "cull 0.5", MESHLET_STRATEGY_CULL, 0.5f, 0 },
+        { "cull 1.0", MESHLET_STRATEGY_CULL, 1.f, 0 },
+        { "cull 1.0/p", MESHLET_STRATEGY_CULL, 1.f, 8192 },
+    };
+
+    // fixed cameras on a fibonacci sphere at a few distances around the mesh, the same for every mode
+    const int directionCount = 64;
+    const float distances[] = { 1.5f, 3.f, 6.f, 12.f };
+
+    for (const char* path : paths)
+    {
+        // the meshlets of the renderer are not needed, every mode rebuilds lod 0 below
+        MeshBuildSettings settings;
+        settings.buildMeshlets = false;
+        settings.buildClusterDag = false;
+
+        Mesh mesh;
+        mesh.loadMesh(path, settings);
+
+        const MeshInstance& instance = mesh.m_instances[0];
+        const MeshLod& lod = mesh.m_lods[instance.lodOffset];
+        const uint32_t* indices = &mesh.m_indices[lod.indexOffset];
+
+        std::vector<float> positions = decodeInstancePositions(mesh, instance);
+
+        std::vector<glm::vec3> cameras;
+        for (int i = 0; i < directionCount; ++i)
+        {
+            float y = 1.f - (i + 0.5f) * 2.f / directionCount;
+            float r = sqrtf(1.f - y * y);
+            float phi = i * 2.39996323f;
+            glm::vec3 direction = glm::vec3(cosf(phi) * r, y, sinf(phi) * r);
+
+            for (float distance : distances)
+            {
+                cameras.push_back(instance.center + direction * (distance * instance.radius));
+            }
+        }
+
+        printf("%s: %u triangles, %zu cameras\n", path, lod.indexCount / 3, cameras.size());
+
+        size_t serialMeshlets = 0;
+
+        for (const Mode& mode : modes)
+        {
+            std::vector<meshopt_Meshlet> meshlets;
+            std::vector<uint32_t> meshletVertices;
+            std::vector<uint8_t> meshletTriangles;
+            double buildMs = 0;
+
+            for (int i = 0; i < iterations; ++i)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                buildMeshlets(meshlets, meshletVertices, meshletTriangles, indices, lod.indexCount, positions.data(), instance.vertexCount, sizeof(float) * 3, mode.strategy, mode.coneWeight, mode.partitionTriangles);
+                auto end = std::chrono::high_resolution_clock::now();
+
+                double time = std::chrono::duration<double, std::milli>(end - start).count();
+                buildMs = i ? std::min(buildMs, time) : time;
+            }
+
+            size_t vertices = 0;
+            size_t triangles = 0;
+            size_t rejected = 0;
+
+            for (const meshopt_Meshlet& meshlet : meshlets)
+            {
+                vertices += meshlet.vertex_count;
+                triangles += meshlet.triangle_count;
+
+                // the quantized cone of the task shader
+                meshopt_Bounds bounds = meshopt_computeMeshletBounds(&meshletVertices[meshlet.vertex_offset], &meshletTriangles[meshlet.triangle_offset], meshlet.triangle_count,
+                    positions.data(), instance.vertexCount, sizeof(float) * 3);
+
+                glm::vec3 center = glm::vec3(bounds.center[0], bounds.center[1], bounds.center[2]);
+                glm::vec3 coneAxis = glm::vec3(bounds.cone_axis_s8[0] / 127.f, bounds.cone_axis_s8[1] / 127.f, bounds.cone_axis_s8[2] / 127.f);
+                float coneCutoff = bounds.cone_cutoff_s8 / 127.f;
+
+                for (const glm::vec3& camera : cameras)
+                {
+                    if (glm::dot(center - camera, coneAxis) >= coneCutoff * glm::length(center - camera) + bounds.radius)
+                    {
+                        rejected += meshlet.triangle_count;
+                    }
+                }
+            }
+
+            printf("    %-10s build %7.2f ms, %6zu meshlets, vertex fill %5.1f%%, triangle fill %5.1f%%, cone culled %5.1f%% of triangles",
+                mode.name, buildMs, meshlets.size(), 100.0 * vertices / (meshlets.size() * 64.0), 100.0 * triangles / (meshlets.size() * double(MESHLETTRICOUNT)),
+                100.0 * rejected / (double(triangles) * cameras.size()));
+
+            if (mode.partitionTriangles)
+            {
+                printf(", %+.2f%% meshlets over serial\n", 100.0 * (double(meshlets.size()) / double(serialMeshlets) - 1.0));
+            }
+            else
+            {
+                printf("\n");
+                serialMeshlets = meshlets.size();
+            }
+        }
+    }
+}
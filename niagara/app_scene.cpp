@@ -0,0 +1,197 @@
+#include "app.h"
+
+#include <chrono>
+#include <random>
+
+// a rebuild is started once the summed leaf area has grown by half over the freshly built tree
+#define DRAW_BVH_REBUILD_QUALITY 1.5
+
+void renderApplication::selectDynamicDraws(float fraction)
+{
+    dynamicDraws.clear();
+    dynamicVelocities.clear();
+    dynamicDrawSelected = fraction;
+
+    if (fraction <= 0.f)
+    {
+        return;
+    }
+
+    // the draws are spatially sorted, so every n-th draw spreads the moving ones over the whole scene
+    size_t stride = std::max(size_t(1.f / fraction + 0.5f), size_t(1));
+
+    std::minstd_rand random(42);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+
+    for (size_t i = 0; i < draws.size(); i += stride)
+    {
+        glm::vec3 direction = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(1e-3f));
+        float speed = 10.f + 5.f * unit(random);
+
+        dynamicDraws.push_back(uint32_t(i));
+        dynamicVelocities.push_back(direction * speed);
+    }
+}
+
+void renderApplication::moveDynamicDraws(float deltaTime)
+{
+    std::vector<size_t> jobs(dynamicDraws.size());
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        jobs[i] = i;
+    }
+
+    std::for_each(std::execution::par, jobs.begin(), jobs.end(), [&](size_t job)
+    {
+        uint32_t draw = dynamicDraws[job];
+        glm::vec3& velocity = dynamicVelocities[job];
+        glm::vec3 position = draws[draw].position + velocity * deltaTime;
+
+        // bounce off the bounds the draws were scattered in
+        for (int c = 0; c < 3; ++c)
+        {
+            if (fabsf(position[c]) > sceneRadius)
+            {
+                velocity[c] = -velocity[c];
+                position[c] = glm::clamp(position[c], -sceneRadius, sceneRadius);
+            }
+        }
+
+        draws[draw].position = position;
+    });
+}
+
+void renderApplication::setDrawTransform(uint32_t draw, const glm::vec3& position, float scale, const glm::quat& rotation)
+{
+    draws[draw].position = position;
+    draws[draw].scale = scale;
+    draws[draw].rotation = rotation;
+
+    drawUpdates.markDirty(draw);
+}
+
+void renderApplication::updateDraws()
+{
+    double time = glfwGetTime();
+    float deltaTime = float(std::min(time - dynamicDrawTime, 0.1));
+    dynamicDrawTime = time;
+
+    if (dynamicDrawFraction != dynamicDrawSelected)
+    {
+        selectDynamicDraws(dynamicDrawFraction);
+    }
+
+    if (!dynamicDraws.empty())
+    {
+        moveDynamicDraws(deltaTime);
+
+        for (uint32_t draw : dynamicDraws)
+        {
+            drawUpdates.markDirty(draw);
+        }
+    }
+
+    const std::vector<MeshInstance>& instances = meshes[0].m_instances;
+
+    // everything passed to setDrawTransform since the last frame, not just the dynamic draws
+    const std::vector<uint32_t>& movedDraws = drawUpdates.getDirtyElements();
+
+    std::vector<uint32_t> dirtyLeaves;
+    std::vector<uint32_t> dirtyNodes;
+
+    if (!movedDraws.empty())
+    {
+        drawBvh.refit(draws, instances, movedDraws, dirtyLeaves, dirtyNodes);
+
+        if (drawBvhRebuild.valid())
+        {
+            for (uint32_t draw : movedDraws)
+            {
+                drawBvhRebuildDirty[draw] = 1;
+            }
+        }
+    }
+
+    if (drawBvhRebuild.valid() && drawBvhRebuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        DrawBvh rebuilt = drawBvhRebuild.get();
+
+        std::vector<uint32_t> rebuildMovedDraws;
+        for (size_t i = 0; i < drawBvhRebuildDirty.size(); ++i)
+        {
+            if (drawBvhRebuildDirty[i])
+            {
+                rebuildMovedDraws.push_back(uint32_t(i));
+                drawBvhRebuildDirty[i] = 0;
+            }
+        }
+
+        rebuilt.refit(draws, instances, rebuildMovedDraws, dirtyLeaves, dirtyNodes);
+        drawBvh = std::move(rebuilt);
+
+        // the order and every box change, so they go up whole instead of per element
+        dirtyLeaves.clear();
+        dirtyNodes.clear();
+
+        orderUpdates.markAll();
+        leafUpdates.markAll();
+        nodeUpdates.markAll();
+    }
+    else if (!drawBvhRebuild.valid() && drawBvh.quality() > DRAW_BVH_REBUILD_QUALITY)
+    {
+        std::vector<MeshDraw> snapshot = draws;
+
+        drawBvhRebuild = std::async(std::launch::async, [snapshot = std::move(snapshot), &instances]()
+        {
+            DrawBvh bvh;
+            bvh.build(snapshot, instances);
+            return bvh;
+        });
+    }
+
+    for (uint32_t leaf : dirtyLeaves)
+    {
+        leafUpdates.markDirty(leaf);
+    }
+
+    for (uint32_t node : dirtyNodes)
+    {
+        nodeUpdates.markDirty(node);
+    }
+
+    // the slices of this frame in flight were released by its fence
+    drawUpdates.stage(currentFrame, draws.data());
+    orderUpdates.stage(currentFrame, drawBvh.order.data());
+    leafUpdates.stage(currentFrame, drawBvh.leaves.data());
+    nodeUpdates.stage(currentFrame, drawBvh.nodes.data());
+}
+
+void renderApplication::recordDrawUpdates(VkCommandBuffer commandBuffer)
+{
+    if (!drawUpdates.hasStaged() && !orderUpdates.hasStaged() && !leafUpdates.hasStaged() && !nodeUpdates.hasStaged())
+    {
+        return;
+    }
+
+    GpuScope updateScope(gpuProfiler, commandBuffer, "drawUpdates");
+
+    // the previous frame may still be reading the draws and the tree
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, 0, 0, 0, 0, 0);
+
+    drawUpdates.record(commandBuffer, scatterPipeline, scatterProgram, scatterCS);
+    orderUpdates.record(commandBuffer, scatterPipeline, scatterProgram, scatterCS);
+    leafUpdates.record(commandBuffer, scatterPipeline, scatterProgram, scatterCS);
+    nodeUpdates.record(commandBuffer, scatterPipeline, scatterProgram, scatterCS);
+
+    // draws are read by the cull shaders as well as the vertex, task and mesh stages
+    VkAccessFlags updateAccess = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    VkBufferMemoryBarrier updateBarriers[] =
+    {
+        bufferBarrier(db.buffer, updateAccess, VK_ACCESS_SHADER_READ_BIT),
+        bufferBarrier(bob.buffer, updateAccess, VK_ACCESS_SHADER_READ_BIT),
+        bufferBarrier(blb.buffer, updateAccess, VK_ACCESS_SHADER_READ_BIT),
+        bufferBarrier(bnb.buffer, updateAccess, VK_ACCESS_SHADER_READ_BIT),
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, 0, sizeof(updateBarriers) / sizeof(updateBarriers[0]), updateBarriers, 0, 0);
+}
@@ -24,6 +24,14 @@ static VkShaderStageFlagBits getShaderStage(SpvExecutionModel executionModel)
     {
         return VK_SHADER_STAGE_MESH_BIT_NV;
     } break;
+    case SpvExecutionModelTaskEXT:
+    {
+        return VK_SHADER_STAGE_TASK_BIT_EXT;
+    } break;
+    case SpvExecutionModelMeshEXT:
+    {
+        return VK_SHADER_STAGE_MESH_BIT_EXT;
+    } break;
     default:
         throw std::runtime_error("Unsupported execution model");
         return VkShaderStageFlagBits(0);
@@ -289,11 +297,16 @@ void renderApplication::createGenericGraphicsPipelineLayout(Shaders shaders, VkS
     }
 }
 
-void renderApplication::createGenericGraphicsPipeline(Shaders shaders, VkPipelineCache pipelineCache, VkPipelineLayout inPipelineLayout, VkPipeline& outPipeline)
+void renderApplication::createGenericGraphicsPipeline(Shaders shaders, VkPipelineCache pipelineCache, VkPipelineLayout inPipelineLayout, VkRenderPass inRenderPass, VkPipeline& outPipeline, VkCompareOp depthCompareOp, bool depthWriteEnable)
 {
+    // pipelines without a fragment shader are depth only and have no color attachment
+    uint32_t colorAttachmentCount = 0;
+
     std::vector<VkPipelineShaderStageCreateInfo> stages;
     for (const Shader* shader : shaders)
     {
+        colorAttachmentCount |= shader->stage == VK_SHADER_STAGE_FRAGMENT_BIT;
+
         VkPipelineShaderStageCreateInfo stage = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
         stage.stage = shader->stage;;
         stage.module = shader->module;
@@ -340,7 +353,7 @@ void renderApplication::createGenericGraphicsPipeline(Shaders shaders, VkPipelin
     colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlending.logicOpEnable = VK_FALSE;
     colorBlending.logicOp = VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
+    colorBlending.attachmentCount = colorAttachmentCount;
     colorBlending.pAttachments = &colorBlendAttachment;
     colorBlending.blendConstants[0] = 0.0f;
     colorBlending.blendConstants[1] = 0.0f;
@@ -358,8 +371,8 @@ void renderApplication::createGenericGraphicsPipeline(Shaders shaders, VkPipelin
 
     VkPipelineDepthStencilStateCreateInfo depthStencilState = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
     depthStencilState.depthTestEnable = true;
-    depthStencilState.depthWriteEnable = true;
-    depthStencilState.depthCompareOp = VK_COMPARE_OP_GREATER;
+    depthStencilState.depthWriteEnable = depthWriteEnable;
+    depthStencilState.depthCompareOp = depthCompareOp;
 
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -374,7 +387,7 @@ void renderApplication::createGenericGraphicsPipeline(Shaders shaders, VkPipelin
     pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.pDepthStencilState = &depthStencilState;
     pipelineInfo.layout = inPipelineLayout;
-    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.renderPass = inRenderPass;
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
@@ -528,12 +541,12 @@ void renderApplication::createGraphicsPipeline() {
     Shader taskShader = {};
     if (rtxSupported)
     {
-        std::vector<char> meshShaderCode = readFile("..\\compiledShader\\meshlet.mesh.spv");
+        std::vector<char> meshShaderCode = readFile(meshShaderEXT ? "..\\compiledShader\\meshlet_ext.mesh.spv" : "..\\compiledShader\\meshlet.mesh.spv");
         if (!createShader(meshShader, meshShaderCode))
         {
             throw std::runtime_error("failed to create mesh shader");
         }
-        std::vector<char> taskShaderCode = readFile("..\\compiledShader\\meshlet.task.spv");
+        std::vector<char> taskShaderCode = readFile(meshShaderEXT ? "..\\compiledShader\\meshlet_ext.task.spv" : "..\\compiledShader\\meshlet.task.spv");
         if (!createShader(taskShader, taskShaderCode))
         {
             throw std::runtime_error("failed to create task shader");
@@ -545,12 +558,36 @@ void renderApplication::createGraphicsPipeline() {
         throw std::runtime_error("failed to create comp shader");
     }
 
+    std::vector<char> bvhcullShaderCode = readFile("..\\compiledShader\\bvhcull.comp.spv");
+    if (!createShader(bvhcullCS, bvhcullShaderCode))
+    {
+        throw std::runtime_error("failed to create comp shader");
+    }
+
     std::vector<char> depthreduceShaderCode = readFile("..\\compiledShader\\depthreduce.comp.spv");
     if (!createShader(depthreduceCS, depthreduceShaderCode))
     {
         throw std::runtime_error("failed to create comp shader");
     }
 
+    std::vector<char> meshletcullShaderCode = readFile("..\\compiledShader\\meshletcull.comp.spv");
+    if (!createShader(meshletcullCS, meshletcullShaderCode))
+    {
+        throw std::runtime_error("failed to create comp shader");
+    }
+
+    std::vector<char> visresolveShaderCode = readFile("..\\compiledShader\\visresolve.comp.spv");
+    if (!createShader(visresolveCS, visresolveShaderCode))
+    {
+        throw std::runtime_error("failed to create comp shader");
+    }
+
+    std::vector<char> scatterShaderCode = readFile("..\\compiledShader\\scatter.comp.spv");
+    if (!createShader(scatterCS, scatterShaderCode))
+    {
+        throw std::runtime_error("failed to create comp shader");
+    }
+
     auto vertShaderCode = readFile("..\\compiledShader\\simple.vert.spv");
 
     auto fragShaderCode = readFile("..\\compiledShader\\simple.frag.spv");
@@ -566,23 +603,81 @@ void renderApplication::createGraphicsPipeline() {
         throw std::runtime_error("failed to create frag shader");
     }
 
+    auto depthShaderCode = readFile("..\\compiledShader\\depth.vert.spv");
+
+    Shader depthShader = {};
+    if (!createShader(depthShader, depthShaderCode))
+    {
+        throw std::runtime_error("failed to create vert shader");
+    }
+
+    auto visibilityShaderCode = readFile("..\\compiledShader\\visibility.frag.spv");
+
+    Shader visibilityShader = {};
+    if (!createShader(visibilityShader, visibilityShaderCode))
+    {
+        throw std::runtime_error("failed to create frag shader");
+    }
+
+    auto fragFadeShaderCode = readFile("..\\compiledShader\\simple_fade.frag.spv");
+
+    Shader fragFadeShader = {};
+    if (!createShader(fragFadeShader, fragFadeShaderCode))
+    {
+        throw std::runtime_error("failed to create frag shader");
+    }
+
+    auto visibilityFadeShaderCode = readFile("..\\compiledShader\\visibility_fade.frag.spv");
+
+    Shader visibilityFadeShader = {};
+    if (!createShader(visibilityFadeShader, visibilityFadeShaderCode))
+    {
+        throw std::runtime_error("failed to create frag shader");
+    }
+
     if (rtxSupported)
     {
         createGenericProgram(VK_PIPELINE_BIND_POINT_GRAPHICS, { &taskShader, &meshShader, &fragShader }, sizeof(Globals), rtxGraphicsProgram);
-        createGenericGraphicsPipeline({ &taskShader, &meshShader, &fragShader }, pipelineCache, rtxGraphicsProgram.layout, rtxGraphicsPipeline);
+        createGenericGraphicsPipeline({ &taskShader, &meshShader, &fragShader }, pipelineCache, rtxGraphicsProgram.layout, renderPass, rtxGraphicsPipeline);
+        createGenericGraphicsPipeline({ &taskShader, &meshShader, &visibilityShader }, pipelineCache, rtxGraphicsProgram.layout, renderPassVisibility, rtxVisibilityPipeline);
+        createGenericGraphicsPipeline({ &taskShader, &meshShader, &fragFadeShader }, pipelineCache, rtxGraphicsProgram.layout, renderPass, rtxGraphicsFadePipeline);
+        createGenericGraphicsPipeline({ &taskShader, &meshShader, &visibilityFadeShader }, pipelineCache, rtxGraphicsProgram.layout, renderPassVisibility, rtxVisibilityFadePipeline);
     }
 
     createGenericProgram(VK_PIPELINE_BIND_POINT_COMPUTE, { &drawcullCS }, sizeof(DrawCullData), drawcmdProgram);
     createComputePipeline(pipelineCache, drawcullCS, drawcmdProgram.layout, drawcmdPipeline);
 
+    createGenericProgram(VK_PIPELINE_BIND_POINT_COMPUTE, { &bvhcullCS }, sizeof(BvhCullData), bvhcullProgram);
+    createComputePipeline(pipelineCache, bvhcullCS, bvhcullProgram.layout, bvhcullPipeline);
+
     createGenericProgram(VK_PIPELINE_BIND_POINT_COMPUTE, { &depthreduceCS }, sizeof(DepthReduceData), depthreduceProgram);
     createComputePipeline(pipelineCache, depthreduceCS, depthreduceProgram.layout, depthreducePipeline);
 
+    createGenericProgram(VK_PIPELINE_BIND_POINT_COMPUTE, { &meshletcullCS }, sizeof(MeshletCullData), meshletcullProgram);
+    createComputePipeline(pipelineCache, meshletcullCS, meshletcullProgram.layout, meshletcullPipeline);
+
+    createGenericProgram(VK_PIPELINE_BIND_POINT_COMPUTE, { &visresolveCS }, sizeof(VisibilityResolveData), visresolveProgram);
+    createComputePipeline(pipelineCache, visresolveCS, visresolveProgram.layout, visresolvePipeline);
+
+    createGenericProgram(VK_PIPELINE_BIND_POINT_COMPUTE, { &scatterCS }, sizeof(ScatterData), scatterProgram);
+    createComputePipeline(pipelineCache, scatterCS, scatterProgram.layout, scatterPipeline);
+
     depthSampler = createSampler(device);
 
     createGenericProgram(VK_PIPELINE_BIND_POINT_GRAPHICS, { &vertShader, &fragShader }, sizeof(Globals), graphicsProgram);
-    createGenericGraphicsPipeline({ &vertShader, &fragShader }, pipelineCache, graphicsProgram.layout, graphicsPipeline);
-
+    createGenericGraphicsPipeline({ &vertShader, &fragShader }, pipelineCache, graphicsProgram.layout, renderPass, graphicsPipeline);
+    createGenericGraphicsPipeline({ &vertShader, &visibilityShader }, pipelineCache, graphicsProgram.layout, renderPassVisibility, visibilityPipeline);
+    createGenericGraphicsPipeline({ &vertShader, &fragShader }, pipelineCache, graphicsProgram.layout, renderPass, graphicsEqualPipeline, VK_COMPARE_OP_EQUAL, false);
+    createGenericGraphicsPipeline({ &vertShader, &fragFadeShader }, pipelineCache, graphicsProgram.layout, renderPass, graphicsFadePipeline);
+    createGenericGraphicsPipeline({ &vertShader, &visibilityFadeShader }, pipelineCache, graphicsProgram.layout, renderPassVisibility, visibilityFadePipeline);
+
+    createGenericProgram(VK_PIPELINE_BIND_POINT_GRAPHICS, { &depthShader }, sizeof(Globals), depthProgram);
+    createGenericGraphicsPipeline({ &depthShader }, pipelineCache, depthProgram.layout, renderPassDepth, depthPipeline);
+
+    destroyShader(depthShader);
+    destroyShader(visibilityShader);
+    destroyShader(visibilityFadeShader);
+    destroyShader(fragFadeShader);
     destroyShader(fragShader);
     destroyShader(vertShader);
     if (rtxSupported)
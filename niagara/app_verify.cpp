@@ -0,0 +1,279 @@
+#include "app.h"
+
+typedef std::array<uint32_t, 3> Triangle;
+
+static glm::vec3 rotateQuat(glm::vec3 v, glm::quat q)
+{
+    glm::vec3 u(q.x, q.y, q.z);
+    return v + 2.f * glm::cross(u, glm::cross(u, v) + q.w * v);
+}
+
+// mirrors projectClusterError in mesh_struct.h
+static float projectClusterError(glm::vec3 center, float radius, float error, const MeshDraw& draw, float lodScale)
+{
+    float d = glm::length(rotateQuat(center, draw.rotation) * draw.scale + draw.position) - radius * draw.scale;
+
+    return d > 0.f ? error * draw.scale * lodScale / d : (error > 0.f ? std::numeric_limits<float>::infinity() : 0.f);
+}
+
+static bool meshletInCut(const MeshletLod& lod, const MeshDraw& draw, const MeshletCullData& cullData)
+{
+    return projectClusterError(lod.center, lod.radius, lod.error, draw, cullData.clusterLodScale) <= cullData.clusterLodThreshold
+        && projectClusterError(lod.parentCenter, lod.parentRadius, lod.parentError, draw, cullData.clusterLodScale) > cullData.clusterLodThreshold;
+}
+
+// mirrors the meshlet tests in meshletcull.comp.glsl
+static bool meshletVisible(const Meshlet& meshlet, const MeshDraw& draw, const MeshletCullData& cullData)
+{
+    glm::vec3 center = rotateQuat(meshlet.center, draw.rotation) * draw.scale + draw.position;
+    float radius = meshlet.radius * draw.scale;
+    glm::vec3 coneAxis = rotateQuat(glm::vec3(meshlet.cone_axis[0] / 127.f, meshlet.cone_axis[1] / 127.f, meshlet.cone_axis[2] / 127.f), draw.rotation);
+    float coneCutoff = meshlet.cone_cutoff / 127.f;
+
+    for (int i = 0; i < 6; ++i)
+    {
+        if (!(glm::dot(glm::vec4(center, 1.f), cullData.frustum[i]) > -radius))
+        {
+            return false;
+        }
+    }
+
+    return !(glm::dot(center, coneAxis) >= coneCutoff * glm::length(center) + radius);
+}
+
+void renderApplication::verifyMeshletCull()
+{
+    vkDeviceWaitIdle(device);
+
+    const Mesh& mesh = meshes[0];
+
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    Buffer scratch = {};
+    createBuffer(scratch, device, memProperties, std::max(dcb.size, mcib.size), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    DrawCommandCount counts = {};
+    downloadBuffer(device, commandBuffers[0], graphicsQueue, dccb, scratch, &counts, sizeof(counts));
+
+    std::vector<MeshDrawCommand> commands(counts.drawCommandCount);
+    std::vector<MeshDrawCommand> meshletCommands(counts.drawCommandCount);
+    downloadBuffer(device, commandBuffers[0], graphicsQueue, dcb, scratch, commands.data(), sizeof(MeshDrawCommand) * commands.size());
+    downloadBuffer(device, commandBuffers[0], graphicsQueue, mcdb, scratch, meshletCommands.data(), sizeof(MeshDrawCommand) * meshletCommands.size());
+
+    std::vector<uint32_t> indices(meshletCullData.indexOffset + std::min(counts.meshletCullIndexCount, meshletCullData.indexCapacity));
+    downloadBuffer(device, commandBuffers[0], graphicsQueue, mcib, scratch, indices.data(), sizeof(uint32_t) * indices.size());
+
+    destroyBuffer(scratch, device);
+
+    uint32_t fallbackCount = 0;
+    uint32_t mismatchCount = 0;
+    size_t expectedTriangles = 0;
+    size_t emittedTriangles = 0;
+
+    std::vector<Triangle> expected;
+    std::vector<Triangle> emitted;
+
+    for (uint32_t i = 0; i < counts.drawCommandCount; ++i)
+    {
+        const MeshDrawCommand& command = commands[i];
+        const VkDrawIndexedIndirectCommand& result = meshletCommands[i].indirect;
+
+        if (result.firstIndex < meshletCullData.indexOffset)
+        {
+            fallbackCount++;
+            continue;
+        }
+
+        expected.clear();
+        emitted.clear();
+
+        for (uint32_t mi = command.meshletOffset; mi < command.meshletOffset + command.meshletCount; ++mi)
+        {
+            const Meshlet& meshlet = mesh.m_meshlets[mi];
+
+            if (!meshletInCut(mesh.m_meshlet_lods[mi], draws[command.drawId], meshletCullData))
+            {
+                continue;
+            }
+
+            if (meshletCullData.cullingEnabled && !meshletVisible(meshlet, draws[command.drawId], meshletCullData))
+            {
+                continue;
+            }
+
+            for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+            {
+                Triangle triangle;
+                for (uint32_t k = 0; k < 3; ++k)
+                {
+                    uint8_t local = mesh.m_meshlet_triangles[meshlet.triangleOffset + t * 3 + k];
+                    triangle[k] = mesh.meshletVertex(meshlet, local);
+                }
+                expected.push_back(triangle);
+            }
+        }
+
+        for (uint32_t t = 0; t < result.indexCount / 3; ++t)
+        {
+            const uint32_t* triangle = &indices[result.firstIndex + t * 3];
+            emitted.push_back({ triangle[0], triangle[1], triangle[2] });
+        }
+
+        // meshlets are compacted in whatever order the gpu accepted them
+        std::sort(expected.begin(), expected.end());
+        std::sort(emitted.begin(), emitted.end());
+
+        expectedTriangles += expected.size();
+        emittedTriangles += emitted.size();
+
+        if (expected != emitted)
+        {
+            if (mismatchCount < 8)
+            {
+                std::cout << "draw command " << i << " (draw " << command.drawId << "): expected " << expected.size() << " triangles, gpu emitted " << emitted.size() << std::endl;
+            }
+            mismatchCount++;
+        }
+    }
+
+    // meshlets sitting exactly on a cull threshold can legitimately flip between cpu and gpu float math
+    std::cout << "meshlet cull verification: " << counts.drawCommandCount << " draw commands, " << fallbackCount << " uncompacted, "
+        << mismatchCount << " mismatched; " << expectedTriangles << " triangles expected, " << emittedTriangles << " emitted" << std::endl;
+}
+
+static glm::vec3 vertexColor(const Vertex& v)
+{
+    return decodeVertexNormal(v) * 0.5f + 0.5f;
+}
+
+// cpu reference for visresolve.comp.glsl: decodes every id, checks that the pixel center lies on the named triangle
+// and reshades it for comparison with the gpu resolve
+void renderApplication::verifyVisibilityBuffer()
+{
+    vkDeviceWaitIdle(device);
+
+    const Mesh& mesh = meshes[0];
+
+    bool meshShading = visibilityResolveData.meshShading != 0;
+    bool meshletCullPass = meshletCullEnabled && !meshShading;
+
+    uint32_t width = swapChainExtent.width;
+    uint32_t height = swapChainExtent.height;
+    size_t pixelCount = size_t(width) * height;
+
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    Buffer scratch = {};
+    createBuffer(scratch, device, memProperties, std::max(pixelCount * sizeof(uint32_t) * 2, meshletCullPass ? size_t(mcib.size) : 0), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    std::vector<uint32_t> ids(pixelCount * 2);
+    std::vector<uint8_t> resolved(pixelCount * 4);
+    downloadImage(device, commandBuffers[0], graphicsQueue, visibilityTarget, VK_IMAGE_LAYOUT_GENERAL, width, height, scratch, ids.data(), sizeof(uint32_t) * ids.size());
+    downloadImage(device, commandBuffers[0], graphicsQueue, resolveTarget, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, width, height, scratch, resolved.data(), resolved.size());
+
+    // the vertex path ids index the buffer the main pass was drawn from
+    std::vector<uint32_t> compactedIndices;
+    if (meshletCullPass)
+    {
+        compactedIndices.resize(mcib.size / sizeof(uint32_t));
+        downloadBuffer(device, commandBuffers[0], graphicsQueue, mcib, scratch, compactedIndices.data(), sizeof(uint32_t) * compactedIndices.size());
+    }
+    const std::vector<uint32_t>& indices = meshletCullPass ? compactedIndices : mesh.m_indices;
+
+    destroyBuffer(scratch, device);
+
+    size_t coveredCount = 0;
+    size_t invalidCount = 0;
+    size_t outsideCount = 0;
+    size_t mismatchCount = 0;
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            size_t pixel = size_t(y) * width + x;
+            uint32_t drawId = ids[pixel * 2 + 0];
+            uint32_t triangleId = ids[pixel * 2 + 1];
+
+            if (drawId == VISIBILITY_EMPTY)
+            {
+                continue;
+            }
+
+            coveredCount++;
+
+            Triangle triangle;
+
+            if (meshShading)
+            {
+                uint32_t mi = triangleId >> VISIBILITY_TRIANGLE_BITS;
+                uint32_t local = triangleId & ((1 << VISIBILITY_TRIANGLE_BITS) - 1);
+
+                if (drawId >= draws.size() || mi >= mesh.m_meshlets.size() || local >= mesh.m_meshlets[mi].triangleCount)
+                {
+                    invalidCount++;
+                    continue;
+                }
+
+                const Meshlet& meshlet = mesh.m_meshlets[mi];
+                for (uint32_t k = 0; k < 3; ++k)
+                {
+                    triangle[k] = mesh.meshletVertex(meshlet, mesh.m_meshlet_triangles[meshlet.triangleOffset + local * 3 + k]);
+                }
+            }
+            else
+            {
+                if (drawId >= draws.size() || size_t(triangleId) * 3 + 2 >= indices.size())
+                {
+                    invalidCount++;
+                    continue;
+                }
+
+                triangle = { indices[triangleId * 3 + 0], indices[triangleId * 3 + 1], indices[triangleId * 3 + 2] };
+            }
+
+            const MeshDraw& draw = draws[drawId];
+            const MeshInstance& instance = mesh.m_instances[draw.meshIndex];
+
+            glm::vec4 clip[3];
+            glm::vec3 color[3];
+
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                const Vertex& v = mesh.m_vertices[triangle[k] + draw.vertexOffset];
+
+                clip[k] = visibilityResolveData.projection * glm::vec4(rotateQuat(decodeVertexPosition(v, instance), draw.rotation) * draw.scale + draw.position, 1.f);
+                color[k] = vertexColor(v);
+            }
+
+            glm::vec2 ndc((float(x) + 0.5f) / float(width) * 2.f - 1.f, 1.f - (float(y) + 0.5f) / float(height) * 2.f);
+
+            glm::mat3 homogeneous(glm::vec3(clip[0].x, clip[0].y, clip[0].w), glm::vec3(clip[1].x, clip[1].y, clip[1].w), glm::vec3(clip[2].x, clip[2].y, clip[2].w));
+            glm::vec3 bary = glm::inverse(homogeneous) * glm::vec3(ndc, 1.f);
+            bary /= bary.x + bary.y + bary.z;
+
+            // a wrong id almost never names a triangle that covers the pixel, edges get some slack for the rasterizer's fixed point
+            if (std::min(bary.x, std::min(bary.y, bary.z)) < -1e-2f)
+            {
+                outsideCount++;
+            }
+
+            glm::vec3 shaded = color[0] * bary.x + color[1] * bary.y + color[2] * bary.z;
+
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                int expected = int(glm::clamp(shaded[k], 0.f, 1.f) * 255.f + 0.5f);
+                if (std::abs(expected - int(resolved[pixel * 4 + k])) > 1)
+                {
+                    mismatchCount++;
+                    break;
+                }
+            }
+        }
+    }
+
+    std::cout << "visibility buffer verification (" << (meshShading ? "mesh shading" : "vertex path") << "): " << coveredCount << " covered pixels, "
+        << invalidCount << " invalid ids, " << outsideCount << " outside their triangle, " << mismatchCount << " resolve mismatches" << std::endl;
+}
@@ -0,0 +1,192 @@
+#include "buffer_update.h"
+
+// scatter.comp takes over once there are many ranges of only a few elements each
+static const size_t kScatterMinRanges = 64;
+static const size_t kScatterMaxRangeElements = 4;
+
+// maxStorageBufferOffsetAlignment is at most 256, so both regions of every slice can be bound directly
+static const size_t kStagingAlignment = 256;
+
+static size_t alignSize(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+void coalesceDirtyRanges(const std::vector<uint32_t>& elements, uint32_t maxGap, std::vector<DirtyRange>& ranges)
+{
+    ranges.clear();
+
+    for (uint32_t element : elements)
+    {
+        if (!ranges.empty() && element <= ranges.back().first + ranges.back().count + maxGap)
+        {
+            DirtyRange& range = ranges.back();
+            range.count = std::max(range.count, element + 1 - range.first);
+        }
+        else
+        {
+            ranges.push_back({ element, 1 });
+        }
+    }
+}
+
+void BufferUpdater::create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const Buffer& targetBuffer, size_t targetElementSize, uint32_t frameCount)
+{
+    if (targetElementSize % sizeof(uint32_t) != 0)
+    {
+        throw std::runtime_error("buffer updates need elements of whole words");
+    }
+
+    target = targetBuffer.buffer;
+    elementSize = targetElementSize;
+    elementCount = targetBuffer.size / elementSize;
+
+    // a slice fits every element, so any update that the frame accumulates can be staged
+    payloadOffset = alignSize(sizeof(uint32_t) * elementCount, kStagingAlignment);
+    sliceSize = payloadOffset + alignSize(elementSize * elementCount, kStagingAlignment);
+
+    createBuffer(staging, device, memoryProperties, sliceSize * frameCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    dirtyFlags.assign(elementCount, 0);
+    dirtyElements.clear();
+    allDirty = false;
+    stagedElements = 0;
+}
+
+void BufferUpdater::destroy(VkDevice device)
+{
+    destroyBuffer(staging, device);
+}
+
+void BufferUpdater::markDirty(uint32_t element)
+{
+    if (!dirtyFlags[element])
+    {
+        dirtyFlags[element] = 1;
+        dirtyElements.push_back(element);
+    }
+}
+
+void BufferUpdater::markAll()
+{
+    allDirty = true;
+}
+
+void BufferUpdater::stage(uint32_t frameIndex, const void* source)
+{
+    ranges.clear();
+    copies.clear();
+    stagedElements = 0;
+    stagedFrame = frameIndex;
+    scatter = false;
+
+    if (allDirty)
+    {
+        for (uint32_t element : dirtyElements)
+        {
+            dirtyFlags[element] = 0;
+        }
+
+        ranges.push_back({ 0, uint32_t(elementCount) });
+    }
+    else if (dirtyElements.size() * 16 > elementCount)
+    {
+        // past a sixteenth of the buffer, collecting the flags in order is cheaper than sorting the list
+        dirtyElements.clear();
+
+        for (size_t i = 0; i < elementCount; ++i)
+        {
+            if (dirtyFlags[i])
+            {
+                dirtyElements.push_back(uint32_t(i));
+                dirtyFlags[i] = 0;
+            }
+        }
+
+        coalesceDirtyRanges(dirtyElements, uint32_t(BUFFER_UPDATE_MERGE_GAP / elementSize), ranges);
+    }
+    else
+    {
+        for (uint32_t element : dirtyElements)
+        {
+            dirtyFlags[element] = 0;
+        }
+
+        std::sort(dirtyElements.begin(), dirtyElements.end());
+        coalesceDirtyRanges(dirtyElements, uint32_t(BUFFER_UPDATE_MERGE_GAP / elementSize), ranges);
+    }
+
+    dirtyElements.clear();
+    allDirty = false;
+
+    for (const DirtyRange& range : ranges)
+    {
+        stagedElements += range.count;
+    }
+
+    scatter = ranges.size() >= kScatterMinRanges && stagedElements < ranges.size() * kScatterMaxRangeElements;
+
+    size_t sliceOffset = sliceSize * frameIndex;
+    uint32_t* indices = reinterpret_cast<uint32_t*>(static_cast<char*>(staging.data) + sliceOffset);
+    char* payload = static_cast<char*>(staging.data) + sliceOffset + payloadOffset;
+    const char* elements = static_cast<const char*>(source);
+
+    // the elements are packed in range order, so a copy region or a run of scatter indices follows every range
+    size_t packed = 0;
+
+    for (const DirtyRange& range : ranges)
+    {
+        memcpy(payload + elementSize * packed, elements + elementSize * range.first, elementSize * range.count);
+
+        if (scatter)
+        {
+            for (uint32_t i = 0; i < range.count; ++i)
+            {
+                indices[packed + i] = range.first + i;
+            }
+        }
+        else
+        {
+            copies.push_back({ sliceOffset + payloadOffset + elementSize * packed, elementSize * range.first, elementSize * range.count });
+        }
+
+        packed += range.count;
+    }
+}
+
+void BufferUpdater::record(VkCommandBuffer commandBuffer, VkPipeline scatterPipeline, const Program& scatterProgram, const Shader& scatterShader) const
+{
+    if (stagedElements == 0)
+    {
+        return;
+    }
+
+    if (!scatter)
+    {
+        vkCmdCopyBuffer(commandBuffer, staging.buffer, target, uint32_t(copies.size()), copies.data());
+        return;
+    }
+
+    size_t sliceOffset = sliceSize * stagedFrame;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, scatterPipeline);
+
+    DescriptorInfo descriptors[] =
+    {
+        DescriptorInfo(staging.buffer, sliceOffset, sizeof(uint32_t) * stagedElements),
+        DescriptorInfo(staging.buffer, sliceOffset + payloadOffset, elementSize * stagedElements),
+        target,
+    };
+
+    vkCmdPushDescriptorSetWithTemplateKHR(commandBuffer, scatterProgram.updateTemplate, scatterProgram.layout, 0, descriptors);
+
+    ScatterData scatterData = {};
+    scatterData.wordCount = uint32_t(elementSize * stagedElements / sizeof(uint32_t));
+    scatterData.elementWords = uint32_t(elementSize / sizeof(uint32_t));
+
+    vkCmdPushConstants(commandBuffer, scatterProgram.layout, scatterProgram.pushConstantStages, 0, sizeof(ScatterData), &scatterData);
+
+    // one thread per word, spilling into y past 65535 groups
+    uint32_t groupCount = getGroupCount(scatterData.wordCount, scatterShader.localSizeX);
+    vkCmdDispatch(commandBuffer, std::min(groupCount, 65535u), (groupCount + 65534) / 65535, 1);
+}
@@ -0,0 +1,72 @@
+#ifndef NIAGARA_BUFFER_UPDATE
+#define NIAGARA_BUFFER_UPDATE
+
+#include "niagara_prereq.h"
+#include "common_helper.h"
+
+// gaps of up to this many bytes between dirty elements are uploaded along with them, a copy region costs more than the bytes
+#define BUFFER_UPDATE_MERGE_GAP 256
+
+struct DirtyRange
+{
+    uint32_t first;
+    uint32_t count;
+};
+
+// merges sorted dirty elements into ranges, runs of up to maxGap clean elements between two dirty ones are bridged
+void coalesceDirtyRanges(const std::vector<uint32_t>& elements, uint32_t maxGap, std::vector<DirtyRange>& ranges);
+
+// push constants of scatter.comp
+struct ScatterData
+{
+    uint32_t wordCount;
+    uint32_t elementWords;
+};
+
+// streams the changed elements of a device local buffer through one host visible staging slice per frame in flight
+// dense updates are applied with vkCmdCopyBuffer, many small ranges are packed and written by scatter.comp instead
+class BufferUpdater
+{
+public:
+    void create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const Buffer& target, size_t elementSize, uint32_t frameCount);
+    void destroy(VkDevice device);
+
+    void markDirty(uint32_t element);
+    void markAll();
+
+    // elements passed to markDirty since the last stage, unsorted
+    const std::vector<uint32_t>& getDirtyElements() const { return dirtyElements; }
+
+    // packs the dirty elements of source into the slice of frameIndex, whose fence has to be signaled already
+    void stage(uint32_t frameIndex, const void* source);
+
+    // applies the staged elements; the caller places the barriers so that several updaters share them
+    void record(VkCommandBuffer commandBuffer, VkPipeline scatterPipeline, const Program& scatterProgram, const Shader& scatterShader) const;
+
+    bool hasStaged() const { return stagedElements > 0; }
+    bool usesScatter() const { return scatter; }
+    size_t getStagedBytes() const { return stagedElements * elementSize; }
+    size_t getRangeCount() const { return ranges.size(); }
+
+private:
+    VkBuffer target = VK_NULL_HANDLE;
+    size_t elementSize = 0;
+    size_t elementCount = 0;
+
+    // a slice holds the element indices for scatter.comp followed by the packed elements
+    Buffer staging = {};
+    size_t sliceSize = 0;
+    size_t payloadOffset = 0;
+
+    std::vector<uint8_t> dirtyFlags;
+    std::vector<uint32_t> dirtyElements;
+    bool allDirty = false;
+
+    std::vector<DirtyRange> ranges;
+    std::vector<VkBufferCopy> copies;
+    size_t stagedElements = 0;
+    uint32_t stagedFrame = 0;
+    bool scatter = false;
+};
+
+#endif
@@ -0,0 +1,624 @@
+#include "cluster_dag.h"
+
+// a cluster of a failed group keeps this parent error, so every cut contains it once its own error is acceptable
+static const float kRootError = std::numeric_limits<float>::max();
+
+// undirected edge between two position ids
+static uint64_t edgeKey(uint32_t a, uint32_t b)
+{
+    return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+// sorted edges used by exactly one triangle
+static void collectBorder(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& positionIds, std::vector<uint64_t>& border)
+{
+    std::vector<uint64_t> edges;
+    edges.reserve(indices.size());
+
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        for (size_t e = 0; e < 3; ++e)
+        {
+            uint32_t a = positionIds[indices[i + e]];
+            uint32_t b = positionIds[indices[i + (e + 1) % 3]];
+
+            if (a != b)
+            {
+                edges.push_back(edgeKey(a, b));
+            }
+        }
+    }
+
+    std::sort(edges.begin(), edges.end());
+
+    border.clear();
+
+    for (size_t i = 0; i < edges.size();)
+    {
+        size_t j = i;
+        while (j < edges.size() && edges[j] == edges[i])
+        {
+            ++j;
+        }
+
+        if (j - i == 1)
+        {
+            border.push_back(edges[i]);
+        }
+
+        i = j;
+    }
+}
+
+static void appendClusterIndices(const DagCluster& cluster, std::vector<uint32_t>& indices)
+{
+    for (uint8_t v : cluster.triangles)
+    {
+        indices.push_back(cluster.vertices[v]);
+    }
+}
+
+static DagBounds getClusterBounds(const DagCluster& cluster, const float* vertexPositions, size_t vertexCount, size_t vertexPositionsStride)
+{
+    meshopt_Bounds bounds = meshopt_computeMeshletBounds(cluster.vertices.data(), cluster.triangles.data(), cluster.triangles.size() / 3, vertexPositions, vertexCount, vertexPositionsStride);
+
+    DagBounds result = {};
+    result.center = glm::vec3(bounds.center[0], bounds.center[1], bounds.center[2]);
+    result.radius = bounds.radius;
+    result.error = 0.f;
+
+    return result;
+}
+
+// meshlets of the indices; vertexMap turns the vertices the clusterizer saw into mesh vertices, null when they already are
+static void buildClusters(std::vector<DagCluster>& clusters, const std::vector<uint32_t>& indices, const float* vertexPositions, size_t vertexCount, size_t vertexPositionsStride, const uint32_t* vertexMap, const ClusterDagSettings& settings)
+{
+    std::vector<meshopt_Meshlet> meshlets(meshopt_buildMeshletsBound(indices.size(), settings.maxVertices, settings.maxTriangles));
+    std::vector<uint32_t> meshletVertices(meshlets.size() * settings.maxVertices);
+    std::vector<uint8_t> meshletTriangles(meshlets.size() * settings.maxTriangles * 3);
+
+    // no cone weight: compact clusters make tighter groups and bounds, cone culling matters less than in the lod chain
+    meshlets.resize(meshopt_buildMeshlets(meshlets.data(), meshletVertices.data(), meshletTriangles.data(), indices.data(), indices.size(), vertexPositions, vertexCount, vertexPositionsStride, settings.maxVertices, settings.maxTriangles, 0.f));
+
+    for (const meshopt_Meshlet& meshlet : meshlets)
+    {
+        DagCluster cluster = {};
+        cluster.vertices.assign(meshletVertices.begin() + meshlet.vertex_offset, meshletVertices.begin() + meshlet.vertex_offset + meshlet.vertex_count);
+        cluster.triangles.assign(meshletTriangles.begin() + meshlet.triangle_offset, meshletTriangles.begin() + meshlet.triangle_offset + meshlet.triangle_count * 3);
+
+        if (vertexMap)
+        {
+            for (uint32_t& v : cluster.vertices)
+            {
+                v = vertexMap[v];
+            }
+        }
+
+        clusters.push_back(std::move(cluster));
+    }
+}
+
+// greedy groups of clusters that share the most vertex positions with the group so far; seeds are taken in cluster order and ties
+// go to the lowest cluster, so the grouping only depends on the order of the pending clusters
+static void groupClusters(const ClusterDag& dag, const std::vector<uint32_t>& pending, const std::vector<uint32_t>& positionIds, size_t positionCount, size_t groupSize, std::vector<std::vector<uint32_t>>& groups)
+{
+    size_t count = pending.size();
+
+    std::vector<std::vector<uint32_t>> clusterPositions(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        std::vector<uint32_t>& positions = clusterPositions[i];
+
+        for (uint32_t v : dag.clusters[pending[i]].vertices)
+        {
+            positions.push_back(positionIds[v]);
+        }
+
+        std::sort(positions.begin(), positions.end());
+        positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+    }
+
+    // clusters touching every position, in cluster order
+    std::vector<uint32_t> positionOffsets(positionCount + 1, 0);
+
+    for (const std::vector<uint32_t>& positions : clusterPositions)
+    {
+        for (uint32_t p : positions)
+        {
+            positionOffsets[p + 1]++;
+        }
+    }
+
+    for (size_t p = 0; p < positionCount; ++p)
+    {
+        positionOffsets[p + 1] += positionOffsets[p];
+    }
+
+    std::vector<uint32_t> positionClusters(positionOffsets[positionCount]);
+    std::vector<uint32_t> positionFill(positionOffsets.begin(), positionOffsets.end() - 1);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (uint32_t p : clusterPositions[i])
+        {
+            positionClusters[positionFill[p]++] = uint32_t(i);
+        }
+    }
+
+    // neighbours of every cluster with the number of positions they share
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> adjacency(count);
+    std::vector<uint32_t> shared(count, 0);
+    std::vector<uint32_t> touched;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        touched.clear();
+
+        for (uint32_t p : clusterPositions[i])
+        {
+            for (uint32_t k = positionOffsets[p]; k < positionOffsets[p + 1]; ++k)
+            {
+                uint32_t j = positionClusters[k];
+
+                if (j != i && shared[j]++ == 0)
+                {
+                    touched.push_back(j);
+                }
+            }
+        }
+
+        std::sort(touched.begin(), touched.end());
+
+        for (uint32_t j : touched)
+        {
+            adjacency[i].push_back({ j, shared[j] });
+            shared[j] = 0;
+        }
+    }
+
+    std::vector<uint8_t> assigned(count, 0);
+    std::vector<std::pair<uint32_t, uint32_t>> candidates;
+
+    groups.clear();
+
+    for (size_t seed = 0; seed < count; ++seed)
+    {
+        if (assigned[seed])
+        {
+            continue;
+        }
+
+        std::vector<uint32_t> group = { uint32_t(seed) };
+        assigned[seed] = 1;
+
+        while (group.size() < groupSize)
+        {
+            candidates.clear();
+
+            for (uint32_t member : group)
+            {
+                for (const std::pair<uint32_t, uint32_t>& neighbour : adjacency[member])
+                {
+                    if (assigned[neighbour.first])
+                    {
+                        continue;
+                    }
+
+                    auto it = std::find_if(candidates.begin(), candidates.end(), [&](const std::pair<uint32_t, uint32_t>& c) { return c.first == neighbour.first; });
+
+                    if (it == candidates.end())
+                    {
+                        candidates.push_back(neighbour);
+                    }
+                    else
+                    {
+                        it->second += neighbour.second;
+                    }
+                }
+            }
+
+            if (candidates.empty())
+            {
+                break;
+            }
+
+            std::pair<uint32_t, uint32_t> best = candidates[0];
+
+            for (const std::pair<uint32_t, uint32_t>& c : candidates)
+            {
+                if (c.second > best.second || (c.second == best.second && c.first < best.first))
+                {
+                    best = c;
+                }
+            }
+
+            group.push_back(best.first);
+            assigned[best.first] = 1;
+        }
+
+        for (uint32_t& member : group)
+        {
+            member = pending[member];
+        }
+
+        groups.push_back(std::move(group));
+    }
+}
+
+// the simplified clusters of one group, written by a parallel job and appended in group order afterwards
+struct GroupResult
+{
+    bool simplified = false;
+    float error = 0.f; // in mesh space, relative to the children
+    std::vector<DagCluster> clusters;
+};
+
+static void simplifyGroup(GroupResult& result, const ClusterDag& dag, const std::vector<uint32_t>& group, const float* vertexPositions, size_t vertexPositionsStride, const std::vector<uint32_t>& positionIds, const ClusterDagSettings& settings)
+{
+    std::vector<uint32_t> indices;
+
+    for (uint32_t c : group)
+    {
+        appendClusterIndices(dag.clusters[c], indices);
+    }
+
+    // the group is compacted to its own vertices so that the simplifier and the clusterizer cost what the group costs,
+    // and the open edges of the group become the border that meshopt_SimplifyLockBorder keeps in place
+    std::vector<uint32_t> groupVertices = indices;
+    std::sort(groupVertices.begin(), groupVertices.end());
+    groupVertices.erase(std::unique(groupVertices.begin(), groupVertices.end()), groupVertices.end());
+
+    std::vector<float> positions(groupVertices.size() * 3);
+
+    for (size_t i = 0; i < groupVertices.size(); ++i)
+    {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(vertexPositions) + vertexPositionsStride * groupVertices[i]);
+        positions[i * 3 + 0] = p[0];
+        positions[i * 3 + 1] = p[1];
+        positions[i * 3 + 2] = p[2];
+    }
+
+    std::vector<uint32_t> localIndices(indices.size());
+
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        localIndices[i] = uint32_t(std::lower_bound(groupVertices.begin(), groupVertices.end(), indices[i]) - groupVertices.begin());
+    }
+
+    size_t targetIndexCount = size_t(double(localIndices.size()) * settings.reduction) / 3 * 3;
+    float error = 0.f;
+
+    std::vector<uint32_t> simplified(localIndices.size());
+    simplified.resize(meshopt_simplify(simplified.data(), localIndices.data(), localIndices.size(), positions.data(), groupVertices.size(), sizeof(float) * 3,
+        targetIndexCount, std::numeric_limits<float>::max(), meshopt_SimplifyLockBorder, &error));
+
+    // a group that hardly shrinks would repeat itself at every level, so its children end the chain instead
+    if (simplified.empty() || double(simplified.size()) > double(localIndices.size()) * settings.maxKept)
+    {
+        return;
+    }
+
+    // locked border vertices don't move, but in rare fans a collapse next to the border still drops a border edge;
+    // such a group would crack against its neighbours, so it is treated like one that didn't shrink
+    std::vector<uint32_t> simplifiedIndices(simplified.size());
+
+    for (size_t i = 0; i < simplified.size(); ++i)
+    {
+        simplifiedIndices[i] = groupVertices[simplified[i]];
+    }
+
+    std::vector<uint64_t> border, simplifiedBorder;
+    collectBorder(indices, positionIds, border);
+    collectBorder(simplifiedIndices, positionIds, simplifiedBorder);
+
+    if (border != simplifiedBorder)
+    {
+        return;
+    }
+
+    result.simplified = true;
+    result.error = error * meshopt_simplifyScale(positions.data(), groupVertices.size(), sizeof(float) * 3);
+
+    buildClusters(result.clusters, simplified, positions.data(), groupVertices.size(), sizeof(float) * 3, groupVertices.data(), settings);
+}
+
+void buildClusterDag(ClusterDag& dag, const uint32_t* indices, size_t indexCount, const float* vertexPositions, size_t vertexCount, size_t vertexPositionsStride, const ClusterDagSettings& settings)
+{
+    if (settings.groupSize < 2 || settings.maxVertices > 255 || settings.maxTriangles > 512 || settings.maxTriangles % 4 != 0)
+    {
+        throw std::runtime_error("cluster dag settings exceed the limits of meshopt_buildMeshlets");
+    }
+
+    dag.clusters.clear();
+    dag.groups.clear();
+    dag.levelCount = 0;
+
+    if (indexCount == 0)
+    {
+        return;
+    }
+
+    // vertices that only differ in attributes share a position id, borders are tracked on those
+    std::vector<uint32_t> positionIds(vertexCount);
+    meshopt_Stream stream = { vertexPositions, sizeof(float) * 3, vertexPositionsStride };
+    size_t positionCount = meshopt_generateVertexRemapMulti(positionIds.data(), static_cast<const uint32_t*>(nullptr), vertexCount, vertexCount, &stream, 1);
+
+    std::vector<uint32_t> sourceIndices(indices, indices + indexCount);
+    buildClusters(dag.clusters, sourceIndices, vertexPositions, vertexCount, vertexPositionsStride, nullptr, settings);
+
+    std::vector<uint32_t> pending;
+
+    for (size_t i = 0; i < dag.clusters.size(); ++i)
+    {
+        DagCluster& cluster = dag.clusters[i];
+        cluster.level = 0;
+        cluster.sourceGroup = ~0u;
+        cluster.group = ~0u;
+        cluster.self = getClusterBounds(cluster, vertexPositions, vertexCount, vertexPositionsStride);
+
+        pending.push_back(uint32_t(i));
+    }
+
+    std::vector<std::vector<uint32_t>> groups;
+    std::vector<uint32_t> next;
+
+    for (uint32_t level = 0; pending.size() > 1 && level + 1 < settings.maxLevels; ++level)
+    {
+        groupClusters(dag, pending, positionIds, positionCount, settings.groupSize, groups);
+
+        std::vector<size_t> jobs(groups.size());
+        for (size_t i = 0; i < jobs.size(); ++i)
+        {
+            jobs[i] = i;
+        }
+
+        std::vector<GroupResult> results(groups.size());
+
+        std::for_each(std::execution::par, jobs.begin(), jobs.end(), [&](size_t job)
+        {
+            simplifyGroup(results[job], dag, groups[job], vertexPositions, vertexPositionsStride, positionIds, settings);
+        });
+
+        next.clear();
+
+        for (size_t g = 0; g < groups.size(); ++g)
+        {
+            GroupResult& result = results[g];
+
+            if (!result.simplified)
+            {
+                continue;
+            }
+
+            // the group sphere bounds the spheres of its children, and its error adds to the largest error among them,
+            // so the error projected from any view never shrinks towards the roots
+            DagGroup group = {};
+            group.children = groups[g];
+            group.level = level;
+
+            glm::vec3 center = glm::vec3(0.f);
+            float childError = 0.f;
+
+            for (uint32_t c : group.children)
+            {
+                center += dag.clusters[c].self.center;
+                childError = std::max(childError, dag.clusters[c].self.error);
+            }
+
+            center /= float(group.children.size());
+
+            float radius = 0.f;
+
+            for (uint32_t c : group.children)
+            {
+                radius = std::max(radius, glm::distance(center, dag.clusters[c].self.center) + dag.clusters[c].self.radius);
+            }
+
+            group.bounds.center = center;
+            group.bounds.radius = radius;
+            group.bounds.error = childError + result.error;
+
+            uint32_t groupIndex = uint32_t(dag.groups.size());
+
+            for (uint32_t c : group.children)
+            {
+                dag.clusters[c].group = groupIndex;
+                dag.clusters[c].parent = group.bounds;
+            }
+
+            for (DagCluster& cluster : result.clusters)
+            {
+                cluster.level = level + 1;
+                cluster.sourceGroup = groupIndex;
+                cluster.group = ~0u;
+                cluster.self = group.bounds;
+
+                next.push_back(uint32_t(dag.clusters.size()));
+                dag.clusters.push_back(std::move(cluster));
+            }
+
+            dag.groups.push_back(std::move(group));
+        }
+
+        // children of failed groups keep group ~0u and become roots below
+        pending.swap(next);
+    }
+
+    for (DagCluster& cluster : dag.clusters)
+    {
+        if (cluster.group == ~0u)
+        {
+            cluster.parent = cluster.self;
+            cluster.parent.error = kRootError;
+        }
+
+        dag.levelCount = std::max(dag.levelCount, cluster.level + 1);
+    }
+}
+
+float projectDagError(const DagBounds& bounds, const glm::vec3& viewPosition)
+{
+    float distance = glm::distance(bounds.center, viewPosition) - bounds.radius;
+
+    // inside the sphere any simplification may be arbitrarily close to the viewer
+    if (distance <= 0.f)
+    {
+        return bounds.error > 0.f ? std::numeric_limits<float>::max() : 0.f;
+    }
+
+    return bounds.error / distance;
+}
+
+void selectDagCut(const ClusterDag& dag, const glm::vec3& viewPosition, float threshold, std::vector<uint32_t>& clusters)
+{
+    clusters.clear();
+
+    for (size_t i = 0; i < dag.clusters.size(); ++i)
+    {
+        const DagCluster& cluster = dag.clusters[i];
+
+        if (projectDagError(cluster.self, viewPosition) <= threshold && projectDagError(cluster.parent, viewPosition) > threshold)
+        {
+            clusters.push_back(uint32_t(i));
+        }
+    }
+}
+
+static bool sameBounds(const DagBounds& a, const DagBounds& b)
+{
+    return a.center == b.center && a.radius == b.radius && a.error == b.error;
+}
+
+std::string verifyClusterDag(const ClusterDag& dag, const uint32_t* indices, size_t indexCount, const float* vertexPositions, size_t vertexCount, size_t vertexPositionsStride)
+{
+    std::vector<uint32_t> positionIds(vertexCount);
+    meshopt_Stream stream = { vertexPositions, sizeof(float) * 3, vertexPositionsStride };
+    meshopt_generateVertexRemapMulti(positionIds.data(), static_cast<const uint32_t*>(nullptr), vertexCount, vertexCount, &stream, 1);
+
+    std::vector<uint32_t> sourceIndices(indices, indices + indexCount);
+    std::vector<uint64_t> sourceBorder;
+    collectBorder(sourceIndices, positionIds, sourceBorder);
+
+    std::vector<std::vector<uint32_t>> groupOutputs(dag.groups.size());
+
+    for (size_t i = 0; i < dag.clusters.size(); ++i)
+    {
+        const DagCluster& cluster = dag.clusters[i];
+
+        if (cluster.triangles.empty() || cluster.triangles.size() % 3 != 0)
+        {
+            return "cluster " + std::to_string(i) + " has no whole triangles";
+        }
+
+        if (cluster.level == 0 ? (cluster.sourceGroup != ~0u || cluster.self.error != 0.f) : cluster.sourceGroup >= dag.groups.size())
+        {
+            return "cluster " + std::to_string(i) + " doesn't match its level";
+        }
+
+        if (cluster.sourceGroup != ~0u)
+        {
+            groupOutputs[cluster.sourceGroup].push_back(uint32_t(i));
+
+            if (!sameBounds(cluster.self, dag.groups[cluster.sourceGroup].bounds))
+            {
+                return "cluster " + std::to_string(i) + " doesn't carry the bounds of the group it was built from";
+            }
+        }
+
+        if (cluster.group == ~0u ? cluster.parent.error != kRootError : !sameBounds(cluster.parent, dag.groups[cluster.group].bounds))
+        {
+            return "cluster " + std::to_string(i) + " doesn't carry the bounds of its parent group";
+        }
+
+        // parent spheres contain the child spheres and parent errors are no smaller, up to float rounding
+        float slack = 1e-5f * std::max(cluster.parent.radius, 1.f);
+
+        if (cluster.group != ~0u && (cluster.parent.error < cluster.self.error || glm::distance(cluster.parent.center, cluster.self.center) + cluster.self.radius > cluster.parent.radius + slack))
+        {
+            return "cluster " + std::to_string(i) + " has parent bounds that don't contain its own";
+        }
+    }
+
+    std::vector<uint32_t> groupIndices;
+    std::vector<uint64_t> childBorder, outputBorder;
+
+    for (size_t g = 0; g < dag.groups.size(); ++g)
+    {
+        groupIndices.clear();
+        for (uint32_t c : dag.groups[g].children)
+        {
+            if (dag.clusters[c].group != g)
+            {
+                return "group " + std::to_string(g) + " lists a child of another group";
+            }
+
+            appendClusterIndices(dag.clusters[c], groupIndices);
+        }
+
+        collectBorder(groupIndices, positionIds, childBorder);
+
+        groupIndices.clear();
+        for (uint32_t c : groupOutputs[g])
+        {
+            appendClusterIndices(dag.clusters[c], groupIndices);
+        }
+
+        collectBorder(groupIndices, positionIds, outputBorder);
+
+        if (groupOutputs[g].empty() || childBorder != outputBorder)
+        {
+            return "group " + std::to_string(g) + " moved its border during simplification";
+        }
+    }
+
+    // cuts from inside, around and far away from the mesh at a range of thresholds; a crack between clusters of different levels
+    // would leave an edge used by one triangle, so every cut must have exactly the border of the source mesh
+    glm::vec3 boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+
+    for (uint32_t v : sourceIndices)
+    {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(vertexPositions) + vertexPositionsStride * v);
+        boundsMin = glm::min(boundsMin, glm::vec3(p[0], p[1], p[2]));
+        boundsMax = glm::max(boundsMax, glm::vec3(p[0], p[1], p[2]));
+    }
+
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    float extent = std::max(glm::length(boundsMax - boundsMin), std::numeric_limits<float>::min());
+
+    const glm::vec3 directions[] = { glm::vec3(1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, 1), glm::normalize(glm::vec3(-1, -1, -1)) };
+    const float distances[] = { 0.f, 0.3f, 1.f, 4.f, 32.f };
+    const float thresholds[] = { 0.f, 1e-4f, 1e-3f, 1e-2f, 1e-1f };
+
+    std::vector<uint32_t> cut, cutIndices;
+    std::vector<uint64_t> cutBorder;
+
+    for (const glm::vec3& direction : directions)
+    {
+        for (float distance : distances)
+        {
+            glm::vec3 viewPosition = center + direction * (distance * extent);
+
+            for (float threshold : thresholds)
+            {
+                selectDagCut(dag, viewPosition, threshold, cut);
+
+                cutIndices.clear();
+                for (uint32_t c : cut)
+                {
+                    appendClusterIndices(dag.clusters[c], cutIndices);
+                }
+
+                collectBorder(cutIndices, positionIds, cutBorder);
+
+                if (cutBorder != sourceBorder)
+                {
+                    return "cut at threshold " + std::to_string(threshold) + " from " + std::to_string(distance) + " extents isn't watertight";
+                }
+            }
+        }
+    }
+
+    return std::string();
+}
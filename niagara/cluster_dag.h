@@ -0,0 +1,71 @@
+#ifndef NIAGARA_CLUSTER_DAG
+#define NIAGARA_CLUSTER_DAG
+
+#include "niagara_prereq.h"
+#include "MeshOptimizer/meshoptimizer.h"
+
+#include <string>
+
+// sphere and error of one level of detail of a meshlet group, in mesh space
+struct DagBounds
+{
+    glm::vec3 center;
+    float radius;
+    float error;
+};
+
+// a meshlet of the dag in meshopt_buildMeshlets layout: vertices index the mesh vertices, triangles index vertices
+struct DagCluster
+{
+    std::vector<uint32_t> vertices;
+    std::vector<uint8_t> triangles;
+
+    uint32_t level;
+    uint32_t sourceGroup; // the group this cluster was built from, ~0u at level 0
+    uint32_t group; // the group this cluster was simplified in, ~0u for the roots
+
+    // self bounds the group this cluster was built from, with zero error at level 0
+    // parent bounds the group this cluster was simplified in, roots carry FLT_MAX error so that a cut never goes past them
+    DagBounds self;
+    DagBounds parent;
+};
+
+struct DagGroup
+{
+    std::vector<uint32_t> children;
+    uint32_t level;
+    DagBounds bounds;
+};
+
+struct ClusterDag
+{
+    std::vector<DagCluster> clusters;
+    std::vector<DagGroup> groups;
+    uint32_t levelCount = 0;
+};
+
+struct ClusterDagSettings
+{
+    size_t maxVertices = 64;
+    size_t maxTriangles = MESHLETTRICOUNT;
+    size_t groupSize = 4; // meshlets simplified together with their shared border locked
+    float reduction = 0.5f; // target triangle count of a group relative to its children
+    float maxKept = 0.85f; // a group keeping more of its triangles is not simplified and its children become roots
+    uint32_t maxLevels = 16;
+};
+
+// meshlets of the indices, then groups of adjacent meshlets simplified with locked borders and split into the meshlets of the next level
+// groups are formed and appended in a fixed order, so the same input always gives the same dag
+void buildClusterDag(ClusterDag& dag, const uint32_t* indices, size_t indexCount, const float* vertexPositions, size_t vertexCount, size_t vertexPositionsStride, const ClusterDagSettings& settings);
+
+// the error a cluster bound projects to from a viewer at viewPosition; spheres around the viewer project to FLT_MAX
+float projectDagError(const DagBounds& bounds, const glm::vec3& viewPosition);
+
+// clusters whose own error is within the threshold while the error of their parent group is not
+void selectDagCut(const ClusterDag& dag, const glm::vec3& viewPosition, float threshold, std::vector<uint32_t>& clusters);
+
+// checks that every group kept its border, that bounds grow monotonically towards the roots and that cuts from a few views are as
+// watertight as the source indices; returns an empty string on success, otherwise the first violation
+std::string verifyClusterDag(const ClusterDag& dag, const uint32_t* indices, size_t indexCount, const float* vertexPositions, size_t vertexCount, size_t vertexPositionsStride);
+
+#endif
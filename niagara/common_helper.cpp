@@ -83,6 +83,88 @@ void uploadBuffer(VkDevice device, VkCommandBuffer commandBuffer, VkQueue queue,
 	vkQueueWaitIdle(queue);
 }
 
+void downloadBuffer(VkDevice device, VkCommandBuffer commandBuffer, VkQueue queue, const Buffer& buffer, const Buffer& scratch, void* data, size_t size)
+{
+	if ((scratch.data == nullptr) || (scratch.size < size))
+	{
+		throw std::runtime_error("scratch buffer is not sufficient");
+	}
+
+	vkResetCommandBuffer(commandBuffer, 0);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	VkBufferMemoryBarrier readBarrier = bufferBarrier(buffer.buffer, VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 1, &readBarrier, 0, 0);
+
+	VkBufferCopy region = { 0, 0, VkDeviceSize(size) };
+	vkCmdCopyBuffer(commandBuffer, buffer.buffer, scratch.buffer, 1, &region);
+
+	VkBufferMemoryBarrier hostBarrier = bufferBarrier(scratch.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 1, &hostBarrier, 0, 0);
+
+	vkEndCommandBuffer(commandBuffer);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+	vkQueueWaitIdle(queue);
+
+	memcpy(data, scratch.data, size);
+}
+
+// layout has to be GENERAL or TRANSFER_SRC_OPTIMAL and is left unchanged
+void downloadImage(VkDevice device, VkCommandBuffer commandBuffer, VkQueue queue, const Image& image, VkImageLayout layout, uint32_t width, uint32_t height, const Buffer& scratch, void* data, size_t size)
+{
+	if ((scratch.data == nullptr) || (scratch.size < size))
+	{
+		throw std::runtime_error("scratch buffer is not sufficient");
+	}
+
+	vkResetCommandBuffer(commandBuffer, 0);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	VkImageMemoryBarrier readBarrier = imageBarrier(image.image, VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, layout, layout);
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 0, 0, 1, &readBarrier);
+
+	VkBufferImageCopy region = {};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent = { width, height, 1 };
+	vkCmdCopyImageToBuffer(commandBuffer, image.image, layout, scratch.buffer, 1, &region);
+
+	VkBufferMemoryBarrier hostBarrier = bufferBarrier(scratch.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_DEPENDENCY_BY_REGION_BIT, 0, 0, 1, &hostBarrier, 0, 0);
+
+	vkEndCommandBuffer(commandBuffer);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+	vkQueueWaitIdle(queue);
+
+	memcpy(data, scratch.data, size);
+}
+
 void destroyBuffer(const Buffer& buffer, VkDevice device)
 {
 	vkFreeMemory(device, buffer.memory, 0);
@@ -96,11 +178,12 @@ VkFramebuffer createFramebuffer(VkDevice device, VkRenderPass renderPass, VkImag
 		depthView
 	};
 
+	// depth only render passes pass a null color view
 	VkFramebufferCreateInfo framebufferInfo{};
 	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 	framebufferInfo.renderPass = renderPass;
-	framebufferInfo.attachmentCount = sizeof(attachments) / sizeof(attachments[0]);
-	framebufferInfo.pAttachments = attachments;
+	framebufferInfo.attachmentCount = colorView ? 2 : 1;
+	framebufferInfo.pAttachments = colorView ? attachments : &attachments[1];
 	framebufferInfo.width = width;
 	framebufferInfo.height = height;
 	framebufferInfo.layers = 1;
@@ -224,7 +307,7 @@ glm::vec4 normalizePlane(glm::vec4 p)
 	return p / glm::length(glm::vec3(p.x, p.y, p.z));
 }
 
-VkQueryPool createGenericQueryPool(VkDevice device, uint32_t queryCount, VkQueryType queryType)
+VkQueryPool createGenericQueryPool(VkDevice device, uint32_t queryCount, VkQueryType queryType, VkQueryPipelineStatisticFlags pipelineStatistics)
 {
 	VkQueryPoolCreateInfo createInfo = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
 	createInfo.queryType = queryType;
@@ -232,7 +315,7 @@ VkQueryPool createGenericQueryPool(VkDevice device, uint32_t queryCount, VkQuery
 
 	if (queryType == VK_QUERY_TYPE_PIPELINE_STATISTICS)
 	{
-		createInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT;
+		createInfo.pipelineStatistics = pipelineStatistics ? pipelineStatistics : VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT;
 	}
 
 	VkQueryPool queryPool = 0;
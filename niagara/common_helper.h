@@ -121,6 +121,10 @@ void createBuffer(Buffer& result, VkDevice device, const VkPhysicalDeviceMemoryP
 
 void uploadBuffer(VkDevice device, VkCommandBuffer commandBuffer, VkQueue queue, const Buffer& buffer, const Buffer& scratch, const void* data, size_t size);
 
+void downloadBuffer(VkDevice device, VkCommandBuffer commandBuffer, VkQueue queue, const Buffer& buffer, const Buffer& scratch, void* data, size_t size);
+
+void downloadImage(VkDevice device, VkCommandBuffer commandBuffer, VkQueue queue, const Image& image, VkImageLayout layout, uint32_t width, uint32_t height, const Buffer& scratch, void* data, size_t size);
+
 void destroyBuffer(const Buffer& buffer, VkDevice device);
 
 VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, uint32_t mipLevel, uint32_t levelCount);
@@ -137,7 +141,7 @@ VkBufferMemoryBarrier bufferBarrier(VkBuffer buffer, VkAccessFlags srcAccessMask
 
 glm::vec4 normalizePlane(glm::vec4 p);
 
-VkQueryPool createGenericQueryPool(VkDevice device, uint32_t queryCount, VkQueryType queryType);
+VkQueryPool createGenericQueryPool(VkDevice device, uint32_t queryCount, VkQueryType queryType, VkQueryPipelineStatisticFlags pipelineStatistics = 0);
 
 uint32_t getImageMipLevels(uint32_t width, uint32_t height);
 
@@ -1,6 +1,9 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 
 #include "mesh.h"
+#include "overdraw_analyzer.h"
+#include "cluster_dag.h"
+#include "meshlet_builder.h"
 
 glm::mat4 MakeInfReversedZProjRH(float fovY_radians, float aspectWbyH, float zNear)
 {
@@ -12,8 +15,87 @@ glm::mat4 MakeInfReversedZProjRH(float fovY_radians, float aspectWbyH, float zNe
         0.0f, 0.0f, zNear, 0.0f);
 }
 
-void Mesh::loadMesh(std::string objpath, bool buildMeshlets)
+static float signNotZero(float v)
 {
+    return v >= 0.f ? 1.f : -1.f;
+}
+
+// projects the unit normal onto the octahedron and folds the lower hemisphere over the diagonals
+static glm::vec2 encodeOctahedron(glm::vec3 n)
+{
+    n /= fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+
+    glm::vec2 e = glm::vec2(n.x, n.y);
+    if (n.z < 0.f)
+    {
+        e = glm::vec2((1.f - fabsf(n.y)) * signNotZero(n.x), (1.f - fabsf(n.x)) * signNotZero(n.y));
+    }
+    return e;
+}
+
+// vertex cache and overdraw statistics of all lods of an asset, before [0] and after [1] the overdraw pass
+struct IndexOrderStatistics
+{
+    size_t triangles = 0;
+    size_t verticesTransformed[2] = {};
+    size_t pixelsCovered[2] = {};
+    size_t pixelsShaded[2] = {};
+};
+
+static void analyzeIndexOrder(const std::vector<uint32_t>& indices, const std::vector<SourceVertex>& vertices, IndexOrderStatistics& stats, int pass)
+{
+    meshopt_VertexCacheStatistics vcs = meshopt_analyzeVertexCache(indices.data(), indices.size(), vertices.size(), 16, 0, 0);
+    meshopt_OverdrawStatistics os = analyzeOverdrawParallel(indices.data(), indices.size(), &vertices[0].px, vertices.size(), sizeof(SourceVertex));
+
+    stats.verticesTransformed[pass] += vcs.vertices_transformed;
+    stats.pixelsCovered[pass] += os.pixels_covered;
+    stats.pixelsShaded[pass] += os.pixels_shaded;
+}
+
+// expects vertex cache optimized indices; the threshold bounds how much the cache efficiency may degrade in exchange for less overdraw
+// statistics are only gathered with settings.analyzeIndexOrder, and only once when the pass is disabled and leaves the indices as they are
+static void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<SourceVertex>& vertices, const MeshBuildSettings& settings, IndexOrderStatistics& stats)
+{
+    stats.triangles += indices.size() / 3;
+
+    if (settings.analyzeIndexOrder)
+    {
+        analyzeIndexOrder(indices, vertices, stats, 0);
+    }
+
+    if (settings.optimizeOverdraw)
+    {
+        meshopt_optimizeOverdraw(indices.data(), indices.data(), indices.size(), &vertices[0].px, vertices.size(), sizeof(SourceVertex), settings.overdrawThreshold);
+
+        if (settings.analyzeIndexOrder)
+        {
+            analyzeIndexOrder(indices, vertices, stats, 1);
+        }
+    }
+}
+
+glm::vec3 decodeVertexPosition(const Vertex& v, const MeshInstance& mesh)
+{
+    return mesh.positionOffset + glm::vec3(v.px, v.py, v.pz) / 65535.f * mesh.positionScale;
+}
+
+glm::vec3 decodeVertexNormal(const Vertex& v)
+{
+    glm::vec2 e = glm::max(glm::vec2(v.nu, v.nv) / 127.f, glm::vec2(-1.f));
+    glm::vec3 n = glm::vec3(e, 1.f - fabsf(e.x) - fabsf(e.y));
+    float t = std::max(-n.z, 0.f);
+    n.x += n.x >= 0.f ? -t : t;
+    n.y += n.y >= 0.f ? -t : t;
+    return glm::normalize(n);
+}
+
+void Mesh::loadMesh(std::string objpath, const MeshBuildSettings& settings)
+{
+    if (settings.maxLodCount == 0 || settings.maxLodCount > MESH_MAX_LODS)
+    {
+        throw std::runtime_error("mesh build settings ask for an unsupported number of lods");
+    }
+
 	tinyobj::ObjReaderConfig reader_config;
 	reader_config.mtl_search_path = "./";
 
@@ -41,7 +123,7 @@ void Mesh::loadMesh(std::string objpath, bool buildMeshlets)
     });
 
     size_t num_indices = num_triangles * 3;
-    std::vector<Vertex> triangle_vertices(num_indices);
+    std::vector<SourceVertex> triangle_vertices(num_indices);
 
     // Loop over shapes
     uint32_t curr_tri = 0;
@@ -71,9 +153,9 @@ void Mesh::loadMesh(std::string objpath, bool buildMeshlets)
                     tinyobj::real_t nx = attrib.normals[3 * size_t(idx.normal_index) + 0];
                     tinyobj::real_t ny = attrib.normals[3 * size_t(idx.normal_index) + 1];
                     tinyobj::real_t nz = attrib.normals[3 * size_t(idx.normal_index) + 2];
-                    triangle_vertices[(uint64_t)curr_tri * 3 + v].nx = uint8_t(nx * 127.f + 127.f);
-                    triangle_vertices[(uint64_t)curr_tri * 3 + v].ny = uint8_t(ny * 127.f + 127.f);
-                    triangle_vertices[(uint64_t)curr_tri * 3 + v].nz = uint8_t(nz * 127.f + 127.f);
+                    triangle_vertices[(uint64_t)curr_tri * 3 + v].nx = nx;
+                    triangle_vertices[(uint64_t)curr_tri * 3 + v].ny = ny;
+                    triangle_vertices[(uint64_t)curr_tri * 3 + v].nz = nz;
                 }
 
                 // Check if `texcoord_index` is zero or positive. negative = no texcoord data
@@ -101,24 +183,27 @@ void Mesh::loadMesh(std::string objpath, bool buildMeshlets)
     //m_indices.resize(num_indices);
     //std::iota(std::begin(m_indices), std::end(m_indices), 0);
     std::vector<uint32_t> remap(num_indices);
-    size_t num_unique_vertices = meshopt_generateVertexRemap((unsigned int *)remap.data(), 0, num_indices, triangle_vertices.data(), num_indices, sizeof(Vertex));
+    size_t num_unique_vertices = meshopt_generateVertexRemap((unsigned int *)remap.data(), 0, num_indices, triangle_vertices.data(), num_indices, sizeof(SourceVertex));
 
-    std::vector<Vertex> vertices(num_unique_vertices);
+    std::vector<SourceVertex> vertices(num_unique_vertices);
     std::vector<uint32_t> indices(num_indices);
 
-    meshopt_remapVertexBuffer(vertices.data(), triangle_vertices.data(), num_indices, sizeof(Vertex), remap.data());
+    meshopt_remapVertexBuffer(vertices.data(), triangle_vertices.data(), num_indices, sizeof(SourceVertex), remap.data());
     meshopt_remapIndexBuffer(indices.data(), 0, num_indices, remap.data());
 
     meshopt_optimizeVertexCache(indices.data(), indices.data(), num_indices, num_unique_vertices);
-    meshopt_optimizeVertexFetch(vertices.data(), indices.data(), num_indices, vertices.data(), num_unique_vertices, sizeof(Vertex));
+
+    // lod 0 is reordered before the vertex fetch pass so that the vertex order follows the final triangle order
+    IndexOrderStatistics indexOrderStats;
+    optimizeOverdraw(indices, vertices, settings, indexOrderStats);
+
+    meshopt_optimizeVertexFetch(vertices.data(), indices.data(), num_indices, vertices.data(), num_unique_vertices, sizeof(SourceVertex));
 
     MeshInstance mesh = {};
 
     mesh.vertexOffset = uint32_t(m_vertices.size());
     mesh.vertexCount = uint32_t(vertices.size());
 
-    m_vertices.insert(m_vertices.end(), vertices.begin(), vertices.end());
-
     glm::vec3 center = glm::vec3(0);
 
     for (auto& v : vertices)
@@ -138,104 +223,352 @@ void Mesh::loadMesh(std::string objpath, bool buildMeshlets)
     mesh.center = center;
     mesh.radius = radius;
 
+    glm::vec3 positionMin = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 positionMax = glm::vec3(-std::numeric_limits<float>::max());
+
+    for (auto& v : vertices)
+    {
+        positionMin = glm::min(positionMin, glm::vec3(v.px, v.py, v.pz));
+        positionMax = glm::max(positionMax, glm::vec3(v.px, v.py, v.pz));
+    }
+
+    mesh.positionOffset = positionMin;
+    mesh.positionScale = glm::max(positionMax - positionMin, glm::vec3(std::numeric_limits<float>::min()));
+
+    float positionErrorMax = 0.f, positionErrorSum = 0.f;
+    float normalErrorMax = 0.f, normalErrorSum = 0.f;
+    size_t normalCount = 0;
+
+    for (auto& v : vertices)
+    {
+        glm::vec3 position = glm::vec3(v.px, v.py, v.pz);
+        glm::vec3 unorm = (position - mesh.positionOffset) / mesh.positionScale;
+
+        Vertex qv = {};
+        qv.px = uint16_t(meshopt_quantizeUnorm(unorm.x, 16));
+        qv.py = uint16_t(meshopt_quantizeUnorm(unorm.y, 16));
+        qv.pz = uint16_t(meshopt_quantizeUnorm(unorm.z, 16));
+        qv.tu = v.tu;
+        qv.tv = v.tv;
+
+        glm::vec3 normal = glm::vec3(v.nx, v.ny, v.nz);
+        float normalLength = glm::length(normal);
+
+        if (normalLength > 0.f)
+        {
+            glm::vec2 octahedron = encodeOctahedron(normal / normalLength);
+            qv.nu = int8_t(meshopt_quantizeSnorm(octahedron.x, 8));
+            qv.nv = int8_t(meshopt_quantizeSnorm(octahedron.y, 8));
+
+            float angle = acosf(glm::clamp(glm::dot(normal / normalLength, decodeVertexNormal(qv)), -1.f, 1.f));
+            normalErrorMax = std::max(normalErrorMax, angle);
+            normalErrorSum += angle;
+            normalCount++;
+        }
+
+        float positionError = glm::distance(position, decodeVertexPosition(qv, mesh));
+        positionErrorMax = std::max(positionErrorMax, positionError);
+        positionErrorSum += positionError;
+
+        m_vertices.push_back(qv);
+
+        m_positions.push_back(qv.px);
+        m_positions.push_back(qv.py);
+        m_positions.push_back(qv.pz);
+        m_positions.push_back(0);
+    }
+
+    // position error relative to the bounds diagonal, normal error in degrees
+    float diagonal = std::max(glm::length(positionMax - positionMin), std::numeric_limits<float>::min());
+    std::cout << objpath << ": " << vertices.size() << " vertices, " << sizeof(Vertex) << " bytes each (" << sizeof(SourceVertex) << " unquantized); position error max "
+        << positionErrorMax / diagonal << " avg " << positionErrorSum / std::max(vertices.size(), size_t(1)) / diagonal << " of bounds; normal error max "
+        << glm::degrees(normalErrorMax) << " avg " << glm::degrees(normalErrorSum / std::max(normalCount, size_t(1))) << " degrees" << std::endl;
+
     std::vector<uint32_t> lodIndices = indices;
 
-    while (mesh.lodCount < (sizeof(mesh.lods) / sizeof(MeshLod)))
+    size_t meshletStart = m_meshlets.size();
+    size_t meshletVerticesStart = m_meshlet_vertices.size();
+    size_t meshletTrianglesStart = m_meshlet_triangles.size();
+
+    mesh.lodOffset = uint32_t(m_lods.size());
+
+    // simplifier errors are relative to the mesh extents, lods store them in mesh space
+    float lodScale = meshopt_simplifyScale(&vertices[0].px, vertices.size(), sizeof(SourceVertex));
+    float lodError = 0.f;
+
+    std::vector<uint32_t> nextLodIndices(lodIndices.size());
+    uint32_t sloppyLodCount = 0;
+    bool sloppy = false;
+
+    while (mesh.lodCount < settings.maxLodCount)
     {
-        MeshLod& lod = mesh.lods[mesh.lodCount++];
+        mesh.lodCount++;
 
+        MeshLod lod = {};
         lod.indexOffset = uint32_t(m_indices.size());
         lod.indexCount = uint32_t(lodIndices.size());
 
         m_indices.insert(m_indices.end(), lodIndices.begin(), lodIndices.end());
 
         lod.meshletOffset = uint32_t(m_meshlets.size());
-        lod.meshletCount = buildMeshlets ? uint32_t(appendMeshlets(vertices, lodIndices, lod.meshletOffset)) : 0;
+        lod.meshletCount = settings.buildMeshlets ? uint32_t(appendMeshlets(vertices, lodIndices, settings)) : 0;
+        lod.error = lodError * lodScale;
+
+        m_lods.push_back(lod);
 
-        if (mesh.lodCount < (sizeof(mesh.lods) / sizeof(MeshLod)))
+        if (mesh.lodCount < settings.maxLodCount)
         {
-            size_t nextIndicesTarget = size_t(double(lodIndices.size()) * 0.75);
-            // this simplification method picks an end point for a collapsed edge. 
-            size_t nextIndices = meshopt_simplify(lodIndices.data(), lodIndices.data(), lodIndices.size(), &vertices[0].px, vertices.size(), sizeof(Vertex), nextIndicesTarget, 1e-2f);
-            //(unsigned int* destination, const unsigned int* indices, size_t index_count, const float* vertex_positions, size_t vertex_count, size_t vertex_positions_stride, size_t target_index_count, float target_error, unsigned int options, float* result_error);
+            size_t nextIndicesTarget = size_t(double(lodIndices.size()) * settings.lodReduction);
+            size_t nextIndices = 0;
+            float nextError = 0.f;
 
-            assert(nextIndices <= lodIndices.size());
+            if (!sloppy)
+            {
+                // this simplification method picks an end point for a collapsed edge. 
+                nextIndices = meshopt_simplify(nextLodIndices.data(), lodIndices.data(), lodIndices.size(), &vertices[0].px, vertices.size(), sizeof(SourceVertex), nextIndicesTarget, settings.lodTargetError, 0, &nextError);
+                //(unsigned int* destination, const unsigned int* indices, size_t index_count, const float* vertex_positions, size_t vertex_count, size_t vertex_positions_stride, size_t target_index_count, float target_error, unsigned int options, float* result_error);
+
+                assert(nextIndices <= lodIndices.size());
+
+                // simplification stalled at the error limit, usually on attribute seams and open borders
+                // the sloppy simplifier ignores topology and keeps reducing the remaining lods
+                if (nextIndices == lodIndices.size() || double(nextIndices) > double(lodIndices.size()) * (1.0 - settings.lodMinReduction))
+                {
+                    if (!settings.lodSloppyFallback)
+                    {
+                        break;
+                    }
+
+                    sloppy = true;
+                }
+            }
 
-            if (nextIndices == lodIndices.size())
+            if (sloppy)
             {
-                break;
+                nextIndices = meshopt_simplifySloppy(nextLodIndices.data(), lodIndices.data(), lodIndices.size(), &vertices[0].px, vertices.size(), sizeof(SourceVertex), nextIndicesTarget, settings.lodSloppyTargetError, &nextError);
+
+                if (nextIndices == 0 || nextIndices >= lodIndices.size())
+                {
+                    break;
+                }
+
+                sloppyLodCount++;
             }
 
-            lodIndices.resize(nextIndices);
+            // each step measures its error against the previous lod, the sum bounds the error against the full mesh
+            lodError += nextError;
+
+            lodIndices.assign(nextLodIndices.begin(), nextLodIndices.begin() + nextIndices);
             meshopt_optimizeVertexCache(lodIndices.data(), lodIndices.data(), lodIndices.size(), num_unique_vertices);
+            optimizeOverdraw(lodIndices, vertices, settings, indexOrderStats);
+        }
+    }
+
+    if (settings.buildMeshlets && settings.buildClusterDag)
+    {
+        // the dag is built from lod 0 and duplicates it as its first level, so the lod chain stays usable without it
+        ClusterDag dag;
+        buildClusterDag(dag, indices.data(), indices.size(), &vertices[0].px, vertices.size(), sizeof(SourceVertex), ClusterDagSettings());
+
+        mesh.clusterOffset = uint32_t(m_meshlets.size());
+        mesh.clusterCount = uint32_t(dag.clusters.size());
+
+        size_t rootCount = 0;
+
+        for (const DagCluster& cluster : dag.clusters)
+        {
+            MeshletLod lod = {};
+            lod.center = cluster.self.center;
+            lod.radius = cluster.self.radius;
+            lod.error = cluster.self.error;
+            lod.parentCenter = cluster.parent.center;
+            lod.parentRadius = cluster.parent.radius;
+            lod.parentError = cluster.parent.error;
+
+            appendMeshlet(vertices, cluster.vertices.data(), cluster.vertices.size(), cluster.triangles.data(), cluster.triangles.size() / 3, lod);
+
+            rootCount += cluster.group == ~0u;
+        }
+
+        std::cout << objpath << ": cluster dag of " << dag.clusters.size() << " meshlets in " << dag.levelCount << " levels, " << dag.groups.size() << " groups, " << rootCount << " roots" << std::endl;
+
+        if (settings.keepClusterDag)
+        {
+            MeshClusterDag kept;
+            kept.positions.reserve(vertices.size() * 3);
+
+            for (const SourceVertex& v : vertices)
+            {
+                kept.positions.push_back(v.px);
+                kept.positions.push_back(v.py);
+                kept.positions.push_back(v.pz);
+            }
+
+            kept.dag = std::move(dag);
+            m_clusterDags.push_back(std::move(kept));
         }
     }
 
     m_instances.push_back(mesh);
+    m_instanceNames.push_back(objpath);
+
+    std::cout << objpath << ": " << mesh.lodCount << " lods (" << sloppyLodCount << " sloppy), " << lodIndices.size() / 3 << " triangles and " << m_lods.back().error
+        << " error in the last lod; " << mesh.lodCount * sizeof(MeshLod) << " bytes of lod table, " << sizeof(MeshInstance) << " byte instance record" << std::endl;
+
+    // over all lods, acmr for a 16 entry cache
+    if (settings.analyzeIndexOrder)
+    {
+        int after = settings.optimizeOverdraw ? 1 : 0;
+
+        std::cout << objpath << ": acmr " << double(indexOrderStats.verticesTransformed[0]) / double(indexOrderStats.triangles) << " -> " << double(indexOrderStats.verticesTransformed[after]) / double(indexOrderStats.triangles)
+            << ", overdraw " << double(indexOrderStats.pixelsShaded[0]) / double(std::max(indexOrderStats.pixelsCovered[0], size_t(1))) << " -> " << double(indexOrderStats.pixelsShaded[after]) / double(std::max(indexOrderStats.pixelsCovered[after], size_t(1)))
+            << (settings.optimizeOverdraw ? "" : " (overdraw pass disabled)") << std::endl;
+    }
+
+    if (settings.buildMeshlets)
+    {
+        // the previous layout interleaved 32-bit vertex indices and packed triangles in one stream, next to a 32 byte meshlet header
+        size_t interleavedSize = 0;
+        size_t wideCount = 0;
+        for (size_t i = meshletStart; i < m_meshlets.size(); ++i)
+        {
+            interleavedSize += 32 + (m_meshlets[i].vertexCount + (m_meshlets[i].triangleCount * 3 + 3) / 4) * 4;
+            wideCount += m_meshlets[i].wideVertices;
+        }
+
+        size_t splitSize = (m_meshlets.size() - meshletStart) * sizeof(Meshlet)
+            + (m_meshlet_vertices.size() - meshletVerticesStart) * sizeof(MeshletVertexIndex)
+            + (m_meshlet_triangles.size() - meshletTrianglesStart);
+
+        std::cout << objpath << ": " << m_meshlets.size() - meshletStart << " meshlets, " << splitSize / 1024 << " KB meshlet data (interleaved layout: " << interleavedSize / 1024 << " KB), "
+            << wideCount << " with wide vertex indices" << std::endl;
+    }
 
-    //while (m_meshlets.size() % 32)
-    //{
-    //    m_meshlets.push_back(Meshlet());
-    //}
 }
 
-size_t Mesh::appendMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const uint32_t meshletOffset)
+size_t buildMeshlets(std::vector<meshopt_Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint8_t>& meshletTriangles, const uint32_t* indices, size_t indexCount,
+    const float* vertexPositions, size_t vertexCount, size_t vertexPositionsStride, MeshletStrategy strategy, float coneWeight, size_t partitionTriangles)
 {
     const size_t max_vertices = 64;
     const size_t max_triangles = MESHLETTRICOUNT;
-    std::vector<meshopt_Meshlet> meshlets(meshopt_buildMeshletsBound(indices.size(), max_vertices, max_triangles));
-    std::vector<uint8_t> meshlet_triangles(meshlets.size() * max_triangles * 3);
-    std::vector<uint32_t> meshlet_vertices(meshlets.size() * max_vertices);
 
-    meshlets.resize(meshopt_buildMeshlets(meshlets.data(), meshlet_vertices.data(), meshlet_triangles.data(), indices.data(), indices.size(), (const float*)vertices.data(), vertices.size(), sizeof(Vertex), max_vertices, max_triangles, 1.0));
+    if (strategy != MESHLET_STRATEGY_SCAN && partitionTriangles > 0)
+    {
+        float weight = strategy == MESHLET_STRATEGY_CULL ? coneWeight : 0.f;
+        return buildMeshletsParallel(meshlets, meshletVertices, meshletTriangles, indices, indexCount, vertexPositions, vertexCount, vertexPositionsStride, max_vertices, max_triangles, weight, partitionTriangles);
+    }
 
-    size_t meshletCount = meshlets.size();
+    meshlets.resize(meshopt_buildMeshletsBound(indexCount, max_vertices, max_triangles));
+    meshletTriangles.resize(meshlets.size() * max_triangles * 3);
+    meshletVertices.resize(meshlets.size() * max_vertices);
 
-    m_meshlets.resize(m_meshlets.size() + meshlets.size());
+    size_t meshletCount = 0;
 
-    for (uint32_t i = 0; i < meshlets.size(); ++i)
+    if (strategy == MESHLET_STRATEGY_SCAN)
+    {
+        meshletCount = meshopt_buildMeshletsScan(meshlets.data(), meshletVertices.data(), meshletTriangles.data(), indices, indexCount, vertexCount, max_vertices, max_triangles);
+    }
+    else
     {
-        uint32_t tri_offset = meshlets[i].triangle_offset;
-        uint32_t vert_offset = meshlets[i].vertex_offset;
-        size_t dataOffset = m_meshlet_data.size();
+        float weight = strategy == MESHLET_STRATEGY_CULL ? coneWeight : 0.f;
+        meshletCount = meshopt_buildMeshlets(meshlets.data(), meshletVertices.data(), meshletTriangles.data(), indices, indexCount, vertexPositions, vertexCount, vertexPositionsStride, max_vertices, max_triangles, weight);
+    }
 
-        for (uint32_t j = 0; j < meshlets[i].vertex_count; ++j)
-        {
-            m_meshlet_data.push_back(meshlet_vertices[vert_offset + j]);
-        }
+    meshlets.resize(meshletCount);
+
+    return meshletCount;
+}
 
-        const uint32_t* indexGroups = reinterpret_cast<const uint32_t*>(meshlet_triangles.data() + tri_offset);
-        uint32_t indexGroupCount = (meshlets[i].triangle_count * 3 + 3) / 4;
+size_t Mesh::appendMeshlets(const std::vector<SourceVertex>& vertices, const std::vector<uint32_t>& indices, const MeshBuildSettings& settings)
+{
+    std::vector<meshopt_Meshlet> meshlets;
+    std::vector<uint32_t> meshlet_vertices;
+    std::vector<uint8_t> meshlet_triangles;
 
-        for (uint32_t j = 0; j < indexGroupCount; ++j)
-        {
-            m_meshlet_data.push_back(indexGroups[j]);
-        }
+    buildMeshlets(meshlets, meshlet_vertices, meshlet_triangles, indices.data(), indices.size(), &vertices[0].px, vertices.size(), sizeof(SourceVertex), settings.meshletStrategy, settings.meshletConeWeight, settings.meshletPartitionTriangles);
 
-        int trueOffset = i + meshletOffset;
+    for (const meshopt_Meshlet& meshlet : meshlets)
+    {
+        // outside a cluster dag a meshlet is always part of the cut, whatever its spheres
+        MeshletLod lod = {};
+        lod.error = 0.f;
+        lod.parentError = std::numeric_limits<float>::max();
 
-        m_meshlets[trueOffset].dataOffset = (uint32_t)dataOffset;
-        m_meshlets[trueOffset].triangleCount = (uint8_t)meshlets[i].triangle_count;
-        m_meshlets[trueOffset].vertexCount = (uint8_t)meshlets[i].vertex_count;
+        appendMeshlet(vertices, meshlet_vertices.data() + meshlet.vertex_offset, meshlet.vertex_count, meshlet_triangles.data() + meshlet.triangle_offset, meshlet.triangle_count, lod);
+    }
 
-        meshopt_Bounds bounds = meshopt_computeMeshletBounds(meshlet_vertices.data() + vert_offset, meshlet_triangles.data() + tri_offset, meshlets[i].triangle_count, (const float*)vertices.data(), vertices.size(), sizeof(Vertex));
-        m_meshlets[trueOffset].center = glm::vec3(bounds.center[0], bounds.center[1], bounds.center[2]);
-        m_meshlets[trueOffset].radius = bounds.radius;
-        //m_meshlets[i].cone_apex = glm::vec3(bounds.cone_apex[0], bounds.cone_apex[1], bounds.cone_apex[2]);
-        //m_meshlets[i].padding = 0;
+    return meshlets.size();
+}
 
-        m_meshlets[trueOffset].cone_axis[0] = bounds.cone_axis_s8[0];
-        m_meshlets[trueOffset].cone_axis[1] = bounds.cone_axis_s8[1];
-        m_meshlets[trueOffset].cone_axis[2] = bounds.cone_axis_s8[2];
-        m_meshlets[trueOffset].cone_cutoff = bounds.cone_cutoff_s8;
+uint32_t Mesh::meshletVertex(const Meshlet& meshlet, uint32_t i) const
+{
+    if (meshlet.wideVertices)
+    {
+        return meshlet.vertexBase + (uint32_t(m_meshlet_vertices[meshlet.vertexOffset + i * 2]) | (uint32_t(m_meshlet_vertices[meshlet.vertexOffset + i * 2 + 1]) << 16));
     }
 
-    while (m_meshlets.size() % 32)
+    return meshlet.vertexBase + m_meshlet_vertices[meshlet.vertexOffset + i];
+}
+
+void Mesh::appendMeshlet(const std::vector<SourceVertex>& vertices, const uint32_t* meshletVertices, size_t vertexCount, const uint8_t* meshletTriangles, size_t triangleCount, const MeshletLod& lod)
+{
+    uint32_t vertexBase = ~0u;
+    uint32_t vertexLast = 0;
+
+    for (size_t j = 0; j < vertexCount; ++j)
     {
-        m_meshlets.push_back(Meshlet());
+        vertexBase = std::min(vertexBase, meshletVertices[j]);
+        vertexLast = std::max(vertexLast, meshletVertices[j]);
     }
 
-    return meshletCount;
+    Meshlet result = {};
+    result.vertexBase = vertexBase;
+    result.vertexOffset = uint32_t(m_meshlet_vertices.size());
+
+    // coarse lods and dag clusters index the whole vertex buffer, the few meshlets that span too much of it spend two halves per index
+    result.wideVertices = vertexLast - vertexBase > std::numeric_limits<MeshletVertexIndex>::max();
+
+    for (size_t j = 0; j < vertexCount; ++j)
+    {
+        uint32_t index = meshletVertices[j] - vertexBase;
+
+        if (result.wideVertices)
+        {
+            m_meshlet_vertices.push_back(MeshletVertexIndex(index & 0xffff));
+            m_meshlet_vertices.push_back(MeshletVertexIndex(index >> 16));
+        }
+        else
+        {
+            m_meshlet_vertices.push_back(MeshletVertexIndex(index));
+        }
+    }
+
+    // the mesh shader writes 4 packed indices at a time, so every meshlet starts on a 4 byte boundary
+    result.triangleOffset = uint32_t(m_meshlet_triangles.size());
+
+    m_meshlet_triangles.insert(m_meshlet_triangles.end(), meshletTriangles, meshletTriangles + triangleCount * 3);
+
+    while (m_meshlet_triangles.size() % 4)
+    {
+        m_meshlet_triangles.push_back(0);
+    }
+
+    result.triangleCount = (uint8_t)triangleCount;
+    result.vertexCount = (uint8_t)vertexCount;
+
+    meshopt_Bounds bounds = meshopt_computeMeshletBounds(meshletVertices, meshletTriangles, triangleCount, (const float*)vertices.data(), vertices.size(), sizeof(SourceVertex));
+    result.center = glm::vec3(bounds.center[0], bounds.center[1], bounds.center[2]);
+    result.radius = bounds.radius;
+    //result.cone_apex = glm::vec3(bounds.cone_apex[0], bounds.cone_apex[1], bounds.cone_apex[2]);
+    //result.padding = 0;
+
+    result.cone_axis[0] = bounds.cone_axis_s8[0];
+    result.cone_axis[1] = bounds.cone_axis_s8[1];
+    result.cone_axis[2] = bounds.cone_axis_s8[2];
+    result.cone_cutoff = bounds.cone_cutoff_s8;
+
+    m_meshlets.push_back(result);
+    m_meshlet_lods.push_back(lod);
 }
 
 //void Mesh::buildMeshletCones()
@@ -323,31 +656,48 @@ void Mesh::generateRenderData(VkDevice device, VkCommandBuffer commandBuffer, Vk
 
     createBuffer(vb, device, memoryProperties, sizeof(m_vertices[0]) * m_vertices.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-    createBuffer(ib, device, memoryProperties, sizeof(m_indices[0]) * m_indices.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    createBuffer(pb, device, memoryProperties, sizeof(m_positions[0]) * m_positions.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    createBuffer(ib, device, memoryProperties, sizeof(m_indices[0]) * m_indices.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-    if (rtxSupported)
+    if (!m_meshlets.empty())
     {
         //buildMeshletCones();
         createBuffer(mlb, device, memoryProperties, sizeof(m_meshlets[0]) * m_meshlets.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-        createBuffer(mdb, device, memoryProperties, sizeof(m_meshlet_data[0]) * m_meshlet_data.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        createBuffer(mvb, device, memoryProperties, sizeof(m_meshlet_vertices[0]) * m_meshlet_vertices.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        createBuffer(mtb, device, memoryProperties, sizeof(m_meshlet_triangles[0]) * m_meshlet_triangles.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        createBuffer(meb, device, memoryProperties, sizeof(m_meshlet_lods[0]) * m_meshlet_lods.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
     }
     //memcpy(mb.data, m_meshlets.data(), sizeof(m_meshlets[0]) * m_meshlets.size());
 
     createBuffer(mb, device, memoryProperties, sizeof(m_instances[0]) * m_instances.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    createBuffer(lb, device, memoryProperties, sizeof(m_lods[0]) * m_lods.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-    size_t temp = m_meshlets.empty() ? sizeof(m_indices[0]) * m_indices.size() : std::max(sizeof(m_indices[0]) * m_indices.size(), std::max(sizeof(m_meshlets[0]) * m_meshlets.size(), std::max(sizeof(m_meshlet_data[0]) * m_meshlet_data.size(), sizeof(m_instances[0]) * m_instances.size())));
+    size_t temp = std::max(sizeof(m_indices[0]) * m_indices.size(), sizeof(m_instances[0]) * m_instances.size());
+    temp = std::max(temp, sizeof(m_lods[0]) * m_lods.size());
+    if (!m_meshlets.empty())
+    {
+        temp = std::max(temp, sizeof(m_meshlets[0]) * m_meshlets.size());
+        temp = std::max(temp, sizeof(m_meshlet_vertices[0]) * m_meshlet_vertices.size());
+        temp = std::max(temp, sizeof(m_meshlet_triangles[0]) * m_meshlet_triangles.size());
+        temp = std::max(temp, sizeof(m_meshlet_lods[0]) * m_meshlet_lods.size());
+    }
     Buffer scratch = {};
     createBuffer(scratch, device, memoryProperties, std::max(sizeof(m_vertices[0]) * m_vertices.size(), temp), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-    if (rtxSupported)
+    if (!m_meshlets.empty())
     {
         uploadBuffer(device, commandBuffer, queue, mlb, scratch, m_meshlets.data(), sizeof(m_meshlets[0]) * m_meshlets.size());
-        uploadBuffer(device, commandBuffer, queue, mdb, scratch, m_meshlet_data.data(), sizeof(m_meshlet_data[0]) * m_meshlet_data.size());
+        uploadBuffer(device, commandBuffer, queue, mvb, scratch, m_meshlet_vertices.data(), sizeof(m_meshlet_vertices[0]) * m_meshlet_vertices.size());
+        uploadBuffer(device, commandBuffer, queue, mtb, scratch, m_meshlet_triangles.data(), sizeof(m_meshlet_triangles[0]) * m_meshlet_triangles.size());
+        uploadBuffer(device, commandBuffer, queue, meb, scratch, m_meshlet_lods.data(), sizeof(m_meshlet_lods[0]) * m_meshlet_lods.size());
     }
 
     uploadBuffer(device, commandBuffer, queue, vb, scratch, m_vertices.data(), m_vertices.size() * sizeof(m_vertices[0]));
+    uploadBuffer(device, commandBuffer, queue, pb, scratch, m_positions.data(), m_positions.size() * sizeof(m_positions[0]));
     uploadBuffer(device, commandBuffer, queue, ib, scratch, m_indices.data(), m_indices.size() * sizeof(m_indices[0]));
     uploadBuffer(device, commandBuffer, queue, mb, scratch, m_instances.data(), m_instances.size() * sizeof(m_instances[0]));
+    uploadBuffer(device, commandBuffer, queue, lb, scratch, m_lods.data(), m_lods.size() * sizeof(m_lods[0]));
     //memcpy(vb.data, m_vertices.data(), m_vertices.size() * sizeof(m_vertices[0]));
     //memcpy(ib.data, m_indices.data(), m_indices.size() * sizeof(m_indices[0]));
     destroyBuffer(scratch, device);
@@ -356,12 +706,16 @@ void Mesh::generateRenderData(VkDevice device, VkCommandBuffer commandBuffer, Vk
 void Mesh::destroyRenderData(VkDevice device)
 {
     destroyBuffer(vb, device);
+    destroyBuffer(pb, device);
     destroyBuffer(ib, device);
     destroyBuffer(mb, device);
+    destroyBuffer(lb, device);
 
-    if (rtxSupported)
+    if (!m_meshlets.empty())
     {
         destroyBuffer(mlb, device);
-        destroyBuffer(mdb, device);
+        destroyBuffer(mvb, device);
+        destroyBuffer(mtb, device);
+        destroyBuffer(meb, device);
     }
 }
\ No newline at end of file
@@ -5,13 +5,22 @@
 #include "tiny_obj_loader.h"
 #include "MeshOptimizer/meshoptimizer.h"
 #include "common_helper.h"
+#include "cluster_dag.h"
 
-// a simple & generic vertex layout
-struct Vertex
+// full precision vertex used while loading, simplifying and building meshlets
+struct SourceVertex
 {
 	float px, py, pz;
-	uint8_t nx, ny, nz, nw;
-	//glm::vec3 color;
+	float nx, ny, nz;
+	uint16_t tu, tv;
+};
+
+// 12 byte gpu vertex: 16-bit unorm position relative to the mesh bounds (see MeshInstance), 2x8-bit snorm octahedral normal, half texcoords
+// keep in sync with mesh_struct.h
+struct Vertex
+{
+	uint16_t px, py, pz;
+	int8_t nu, nv;
 	uint16_t tu, tv;
 
 	static VkVertexInputBindingDescription getBindingDescription() 
@@ -27,13 +36,13 @@ struct Vertex
 		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
 		attributeDescriptions[0].binding = 0;
 		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attributeDescriptions[0].format = VK_FORMAT_R16G16B16_UNORM;
 		attributeDescriptions[0].offset = offsetof(Vertex, px);
 
 		attributeDescriptions[1].binding = 0;
 		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UINT;
-		attributeDescriptions[1].offset = offsetof(Vertex, nx);
+		attributeDescriptions[1].format = VK_FORMAT_R8G8_SNORM;
+		attributeDescriptions[1].offset = offsetof(Vertex, nu);
 
 		attributeDescriptions[2].binding = 0;
 		attributeDescriptions[2].location = 2;
@@ -44,6 +53,17 @@ struct Vertex
 	}
 };
 
+// meshlet vertex indices are stored relative to a per-meshlet base vertex, which lets them fit in 16 bits
+// meshlets spanning more vertices are marked wide and store every index as a low and a high half
+// keep in sync with mesh_struct.h
+#define MESHLET_SHORT_VERTICES 1
+
+#if MESHLET_SHORT_VERTICES
+typedef uint16_t MeshletVertexIndex;
+#else
+typedef uint32_t MeshletVertexIndex;
+#endif
+
 struct alignas(16) Meshlet
 {
 	glm::vec3 center;
@@ -53,14 +73,35 @@ struct alignas(16) Meshlet
 	int8_t cone_axis[3];
 	int8_t cone_cutoff;
 
-	uint32_t dataOffset;
+	uint32_t vertexBase; // added to every index read from meshlet vertices
+	uint32_t vertexOffset; // first element in meshlet vertices
+	uint32_t triangleOffset; // byte offset in meshlet triangles, 4 byte aligned
 	uint8_t triangleCount; 
 	uint8_t vertexCount;
+	uint8_t wideVertices; // 1 when the vertex range doesn't fit MeshletVertexIndex, see meshletVertex
+};
+
+// cluster lod bounds, parallel to the meshlets: a meshlet belongs to the view dependent cut when its own error projects within the
+// threshold and the error of the group it was simplified in doesn't; see cluster_dag.h
+// meshlets outside a cluster dag carry zero error and a parent that never passes, so they always belong to the cut
+// keep in sync with mesh_struct.h
+struct alignas(16) MeshletLod
+{
+	glm::vec3 center;
+	float radius;
+	glm::vec3 parentCenter;
+	float parentRadius;
+	float error;
+	float parentError;
 };
 
 struct alignas(16) Globals
 {
 	glm::mat4 projection;
+	int statisticsEnabled;
+	float screenWidth;
+	float screenHeight;
+	float clusterLodThreshold; // in pixels, projected with projection[1][1] * screenHeight / 2
 };
 
 struct alignas(16) DrawCullData
@@ -69,6 +110,102 @@ struct alignas(16) DrawCullData
 	uint32_t drawCount;
 	int cullingEnabled;
 	int lodEnabled;
+	int statisticsEnabled;
+	int meshletCullEnabled;
+	int lodFadeEnabled;
+	int bvhEnabled; // draws come from the leaves that survived bvhcull.comp instead of a linear dispatch
+	int clusterLodEnabled; // meshes with a cluster dag draw it instead of a lod, the cut is selected per meshlet
+};
+
+// written by drawcmd.comp: the draw count, the dispatch size of meshletcull.comp and the compacted index allocator
+struct DrawCommandCount
+{
+	uint32_t drawCommandCount;
+	VkDispatchIndirectCommand meshletCullDispatch;
+	uint32_t meshletCullIndexCount;
+};
+
+struct alignas(16) MeshletCullData
+{
+	glm::vec4 frustum[6];
+	uint32_t indexOffset; // compacted indices start after the copy of the mesh indices
+	uint32_t indexCapacity;
+	int cullingEnabled;
+	int statisticsEnabled;
+	float clusterLodScale; // error to pixels, projection[1][1] * screenHeight / 2
+	float clusterLodThreshold;
+};
+
+// two level bvh over the draws: a leaf boxes up to DRAW_BVH_WIDTH consecutive draws, a node up to DRAW_BVH_WIDTH consecutive leaves
+// keep in sync with mesh_struct.h
+#define DRAW_BVH_WIDTH 64
+
+struct DrawBvhNode
+{
+	glm::vec3 boxMin;
+	uint32_t childOffset;
+	glm::vec3 boxMax;
+	uint32_t childCount;
+};
+
+struct alignas(16) BvhCullData
+{
+	glm::vec4 frustum[6];
+	int cullingEnabled;
+	int statisticsEnabled;
+};
+
+// written by bvhcull.comp and followed by the indices of the surviving leaves; drawcmd.comp runs one workgroup per leaf
+struct VisibleLeafHeader
+{
+	uint32_t leafCount;
+	VkDispatchIndirectCommand drawCullDispatch;
+};
+
+// visibility buffer ids are (drawId, triangle); the vertex path stores the triangle index into the bound index buffer,
+// mesh shading stores (meshlet << VISIBILITY_TRIANGLE_BITS) | local triangle
+// keep in sync with mesh_struct.h
+#define VISIBILITY_TRIANGLE_BITS 7
+#define VISIBILITY_EMPTY 0xffffffffu
+
+struct alignas(16) VisibilityResolveData
+{
+	glm::mat4 projection;
+	float screenWidth;
+	float screenHeight;
+	int meshShading;
+};
+
+// lod selection, the lod histogram and DrawLodState assume no more lods per mesh than this
+#define MESH_MAX_LODS 8
+
+// counters written by the culling shaders when statistics are enabled, read back per frame
+struct CullStatistics
+{
+	uint32_t drawsTested;
+	uint32_t drawsFrustumRejected;
+	uint32_t drawsOcclusionRejected; // the cull shader has no occlusion test yet, so this stays zero
+	uint32_t drawsVisible;
+	uint32_t lodHistogram[MESH_MAX_LODS];
+
+	uint32_t meshletsTested;
+	uint32_t meshletsConeRejected;
+	uint32_t meshletsFrustumRejected; // only the compute fallback tests meshlets against the frustum, the task shaders leave it to the draws
+
+	// per triangle culling in the mesh shaders, see TRIANGLE_CULL
+	uint32_t trianglesTested;
+	uint32_t trianglesRejected;
+
+	uint32_t drawsLodFading; // draws emitted at both lods for a dithered transition
+
+	// hierarchical culling in bvhcull.comp, draws inside rejected nodes and leaves are never tested
+	uint32_t nodesTested;
+	uint32_t nodesRejected;
+	uint32_t leavesTested;
+	uint32_t leavesRejected;
+
+	// meshlets of a cluster dag outside the view dependent cut, tested but not counted as cone rejected
+	uint32_t meshletsLodRejected;
 };
 
 struct alignas(16) MeshDraw
@@ -87,6 +224,23 @@ struct MeshDrawCommand
 	uint32_t drawId;
 	VkDrawIndexedIndirectCommand indirect; // 5 * 4
 	VkDrawMeshTasksIndirectCommandNV indirectMS; // 2 * 4
+	VkDrawMeshTasksIndirectCommandEXT indirectMSEXT; // 3 * 4
+
+	// task groups cover [meshletOffset, meshletOffset + meshletCount), the last group may be partially filled
+	uint32_t meshletOffset;
+	uint32_t meshletCount;
+
+	// screen-door dither factor for lod transitions: 1 draws every pixel, (0, 1) and its negation split the pixels between two lods
+	float lodFade;
+};
+
+// persistent per draw lod selection for hysteresis and cross-fades, owned by drawcmd.comp
+struct DrawLodState
+{
+	uint8_t lod; // 0xff until the draw was first seen
+	uint8_t previousLod;
+	uint8_t fadeFrames;
+	uint8_t padding;
 };
 
 struct MeshLod
@@ -96,6 +250,8 @@ struct MeshLod
 
 	uint32_t meshletOffset;
 	uint32_t meshletCount;
+
+	float error; // simplification error against the full mesh, in mesh space units
 };
 
 struct alignas(16) MeshInstance
@@ -103,42 +259,105 @@ struct alignas(16) MeshInstance
 	glm::vec3 center;
 	float radius;
 
+	// dequantization of Vertex and position stream positions: offset + q / 65535 * scale
+	glm::vec3 positionOffset;
 	uint32_t vertexOffset;
+	glm::vec3 positionScale;
 	uint32_t vertexCount;
 
+	// range in the mesh lod table, lod 0 is the full mesh
+	uint32_t lodOffset;
 	uint32_t lodCount;
 
-	MeshLod lods[8];
+	// meshlets of the cluster dag, drawn with the indices of lod 0 when cluster lod is enabled; zero without a dag
+	uint32_t clusterOffset;
+	uint32_t clusterCount;
+};
+
+// how the meshlets of a lod are clusterized: scan follows the index order and is the fastest, compact only weighs spatial bounds,
+// cull also weighs the normal cones by meshletConeWeight so that more meshlets can be rejected by cone culling
+enum MeshletStrategy
+{
+	MESHLET_STRATEGY_SCAN = 0,
+	MESHLET_STRATEGY_COMPACT = 1,
+	MESHLET_STRATEGY_CULL = 2,
+};
+
+// how loadMesh builds the lod chain and meshlets of one asset
+struct MeshBuildSettings
+{
+	uint32_t maxLodCount = MESH_MAX_LODS;
+	float lodReduction = 0.75f; // target index count of each lod relative to the previous one
+	float lodTargetError = 1e-2f; // meshopt_simplify error limit, relative to the mesh extents
+	float lodMinReduction = 0.f; // below this share of removed indices meshopt_simplify counts as stalled
+	bool lodSloppyFallback = true; // continue a stalled chain with meshopt_simplifySloppy instead of stopping
+	float lodSloppyTargetError = 1.f; // relative error limit of the sloppy lods, the default leaves them bound by the index target only
+	bool optimizeOverdraw = true; // reorder the triangles of every lod for less overdraw after vertex cache optimization
+	float overdrawThreshold = 1.05f; // meshopt_optimizeOverdraw may raise acmr by up to this factor
+	bool analyzeIndexOrder = false; // log acmr and overdraw of all lods before and after the overdraw pass, off at startup as it rasterizes every lod
+	bool buildMeshlets = true;
+	MeshletStrategy meshletStrategy = MESHLET_STRATEGY_CULL;
+	float meshletConeWeight = 1.f; // cone_weight of meshopt_buildMeshlets for MESHLET_STRATEGY_CULL, 0 is as compact as possible
+	size_t meshletPartitionTriangles = 65536; // larger lods are split spatially and clusterized in parallel by compact and cull, 0 always builds serially
+	bool buildClusterDag = true; // meshlets of a cluster dag after the lod chain, needs buildMeshlets
+	bool keepClusterDag = false; // also keep the dag and the positions it was built from in Mesh::m_clusterDags, for --cluster-dag-verify
+};
+
+// a cluster dag as loadMesh built it, with the unquantized lod 0 positions it was built from, 3 floats per vertex
+struct MeshClusterDag
+{
+	ClusterDag dag;
+	std::vector<float> positions;
 };
 
 glm::mat4 MakeInfReversedZProjRH(float fovY_radians, float aspectWbyH, float zNear);
 
+// cpu mirrors of the vertex decoding in mesh_struct.h
+glm::vec3 decodeVertexPosition(const Vertex& v, const MeshInstance& mesh);
+glm::vec3 decodeVertexNormal(const Vertex& v);
+
+// meshlets of up to 64 vertices and MESHLETTRICOUNT triangles in meshopt_buildMeshlets layout; the scan strategy expects vertex cache optimized indices
+size_t buildMeshlets(std::vector<meshopt_Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint8_t>& meshletTriangles, const uint32_t* indices, size_t indexCount,
+	const float* vertexPositions, size_t vertexCount, size_t vertexPositionsStride, MeshletStrategy strategy, float coneWeight, size_t partitionTriangles);
+
 class Mesh
 {
 public:
-	void loadMesh(std::string objpath, bool buildMeshlets);
+	void loadMesh(std::string objpath, const MeshBuildSettings& settings);
 	void generateRenderData(VkDevice device, VkCommandBuffer commandBuffer, VkQueue queue, const VkPhysicalDeviceMemoryProperties& memoryProperties);
 	void destroyRenderData(VkDevice device);
 
+	// mesh relative index of vertex i of a meshlet, reading wide meshlets like the shaders do
+	uint32_t meshletVertex(const Meshlet& meshlet, uint32_t i) const;
+
 	Buffer vb;
+	Buffer pb;
 	Buffer ib;
 	Buffer mlb;
-	Buffer mdb;
+	Buffer mvb;
+	Buffer mtb;
 	Buffer mb;
+	Buffer lb;
+	Buffer meb;
 
 	std::vector<Vertex> m_vertices;
+	// depth only passes and the mesh shaders read the quantized Vertex position from this stream, padded to 8 bytes
+	std::vector<uint16_t> m_positions;
 	std::vector<uint32_t> m_indices;
 	std::vector<Meshlet> m_meshlets;
-	std::vector<uint32_t> m_meshlet_data;
+	std::vector<MeshletLod> m_meshlet_lods;
+	std::vector<MeshletVertexIndex> m_meshlet_vertices;
+	std::vector<uint8_t> m_meshlet_triangles;
 
 	std::vector<MeshInstance> m_instances;
-
-	// To Do: use meshlet_vertices & meshlet_indices buffers
-
-	bool rtxSupported;
+	std::vector<std::string> m_instanceNames;
+	std::vector<MeshLod> m_lods;
+	// in load order, only for meshes loaded with settings.keepClusterDag
+	std::vector<MeshClusterDag> m_clusterDags;
 
 private:
-	size_t appendMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const uint32_t meshletOffset);
+	size_t appendMeshlets(const std::vector<SourceVertex>& vertices, const std::vector<uint32_t>& indices, const MeshBuildSettings& settings);
+	void appendMeshlet(const std::vector<SourceVertex>& vertices, const uint32_t* meshletVertices, size_t vertexCount, const uint8_t* meshletTriangles, size_t triangleCount, const MeshletLod& lod);
 };
 
 #endif
\ No newline at end of file
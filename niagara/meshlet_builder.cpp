@@ -0,0 +1,243 @@
+#include "meshlet_builder.h"
+
+struct Partition
+{
+    size_t offset;
+    size_t count;
+};
+
+struct PartitionMeshlets
+{
+    std::vector<meshopt_Meshlet> meshlets;
+    std::vector<uint32_t> vertices;
+    std::vector<uint8_t> triangles;
+};
+
+// halves every partition that is still too large, both halves stay contiguous in order
+static void splitPartition(std::vector<uint32_t>& order, const std::vector<float>& centroids, const Partition& partition, size_t partitionTriangles, Partition* halves)
+{
+    if (partition.count <= partitionTriangles)
+    {
+        halves[0] = partition;
+        halves[1] = { partition.offset + partition.count, 0 };
+        return;
+    }
+
+    float minv[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+    float maxv[3] = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+
+    for (size_t i = partition.offset; i < partition.offset + partition.count; ++i)
+    {
+        const float* c = &centroids[order[i] * 3];
+
+        for (int j = 0; j < 3; ++j)
+        {
+            minv[j] = std::min(minv[j], c[j]);
+            maxv[j] = std::max(maxv[j], c[j]);
+        }
+    }
+
+    int axis = 0;
+    for (int j = 1; j < 3; ++j)
+    {
+        axis = (maxv[j] - minv[j]) > (maxv[axis] - minv[axis]) ? j : axis;
+    }
+
+    // ties are broken by triangle index so that which triangles end up in each half is well defined, the order within a half is not
+    size_t half = partition.count / 2;
+    std::nth_element(order.begin() + partition.offset, order.begin() + partition.offset + half, order.begin() + partition.offset + partition.count,
+        [&](uint32_t a, uint32_t b)
+        {
+            float ca = centroids[a * 3 + axis];
+            float cb = centroids[b * 3 + axis];
+            return ca < cb || (ca == cb && a < b);
+        });
+
+    halves[0] = { partition.offset, half };
+    halves[1] = { partition.offset + half, partition.count - half };
+}
+
+static void buildPartitionMeshlets(PartitionMeshlets& result, const std::vector<uint32_t>& order, const Partition& partition, const uint32_t* indices,
+    const float* vertexPositions, size_t vertexPositionsStride, size_t maxVertices, size_t maxTriangles, float coneWeight)
+{
+    size_t vertexStrideFloat = vertexPositionsStride / sizeof(float);
+    size_t indexCount = partition.count * 3;
+
+    // meshopt allocates per vertex state, so every partition gets its own compact vertex range instead of the whole mesh
+    std::vector<uint32_t> localIndices(indexCount);
+    for (size_t i = 0; i < partition.count; ++i)
+    {
+        uint32_t triangle = order[partition.offset + i];
+
+        localIndices[i * 3 + 0] = indices[triangle * 3 + 0];
+        localIndices[i * 3 + 1] = indices[triangle * 3 + 1];
+        localIndices[i * 3 + 2] = indices[triangle * 3 + 2];
+    }
+
+    // open addressing from mesh vertices to first use order, the table is at most half full
+    size_t tableSize = 1;
+    while (tableSize < indexCount * 2)
+    {
+        tableSize *= 2;
+    }
+
+    std::vector<uint32_t> tableKeys(tableSize, ~0u);
+    std::vector<uint32_t> tableValues(tableSize);
+    std::vector<uint32_t> localVertices;
+
+    for (uint32_t& index : localIndices)
+    {
+        size_t bucket = (index * 0x9e3779b1u) & (tableSize - 1);
+
+        while (tableKeys[bucket] != ~0u && tableKeys[bucket] != index)
+        {
+            bucket = (bucket + 1) & (tableSize - 1);
+        }
+
+        if (tableKeys[bucket] == ~0u)
+        {
+            tableKeys[bucket] = index;
+            tableValues[bucket] = uint32_t(localVertices.size());
+            localVertices.push_back(index);
+        }
+
+        index = tableValues[bucket];
+    }
+
+    std::vector<float> localPositions(localVertices.size() * 3);
+    for (size_t v = 0; v < localVertices.size(); ++v)
+    {
+        const float* p = vertexPositions + localVertices[v] * vertexStrideFloat;
+
+        localPositions[v * 3 + 0] = p[0];
+        localPositions[v * 3 + 1] = p[1];
+        localPositions[v * 3 + 2] = p[2];
+    }
+
+    result.meshlets.resize(meshopt_buildMeshletsBound(indexCount, maxVertices, maxTriangles));
+    result.vertices.resize(result.meshlets.size() * maxVertices);
+    result.triangles.resize(result.meshlets.size() * maxTriangles * 3);
+
+    result.meshlets.resize(meshopt_buildMeshlets(result.meshlets.data(), result.vertices.data(), result.triangles.data(), localIndices.data(), indexCount,
+        localPositions.data(), localVertices.size(), sizeof(float) * 3, maxVertices, maxTriangles, coneWeight));
+
+    // meshopt packs vertices and aligns every triangle range to 4 bytes, the last meshlet marks the used size of both
+    const meshopt_Meshlet& last = result.meshlets.back();
+
+    result.vertices.resize(last.vertex_offset + last.vertex_count);
+    result.triangles.resize(last.triangle_offset + ((last.triangle_count * 3 + 3) & ~3));
+
+    for (uint32_t& vertex : result.vertices)
+    {
+        vertex = localVertices[vertex];
+    }
+}
+
+size_t buildMeshletsParallel(std::vector<meshopt_Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint8_t>& meshletTriangles,
+    const uint32_t* indices, size_t indexCount, const float* vertexPositions, size_t vertexCount, size_t vertexPositionsStride,
+    size_t maxVertices, size_t maxTriangles, float coneWeight, size_t partitionTriangles)
+{
+    if (indexCount % 3 != 0 || vertexPositionsStride < 12 || vertexPositionsStride % sizeof(float) != 0 || partitionTriangles == 0)
+    {
+        throw std::runtime_error("invalid arguments to buildMeshletsParallel");
+    }
+
+    size_t triangleCount = indexCount / 3;
+    size_t vertexStrideFloat = vertexPositionsStride / sizeof(float);
+
+    // meshes that fit one partition take the serial path and get exactly the meshlets of meshopt_buildMeshlets
+    if (triangleCount <= partitionTriangles)
+    {
+        meshlets.resize(meshopt_buildMeshletsBound(indexCount, maxVertices, maxTriangles));
+        meshletVertices.resize(meshlets.size() * maxVertices);
+        meshletTriangles.resize(meshlets.size() * maxTriangles * 3);
+
+        meshlets.resize(meshopt_buildMeshlets(meshlets.data(), meshletVertices.data(), meshletTriangles.data(), indices, indexCount,
+            vertexPositions, vertexCount, vertexPositionsStride, maxVertices, maxTriangles, coneWeight));
+
+        return meshlets.size();
+    }
+
+    std::vector<uint32_t> order(triangleCount);
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        order[i] = uint32_t(i);
+    }
+
+    std::vector<float> centroids(triangleCount * 3);
+
+    std::for_each(std::execution::par, order.begin(), order.end(), [&](uint32_t triangle)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            float sum = 0.f;
+            for (int k = 0; k < 3; ++k)
+            {
+                sum += vertexPositions[indices[triangle * 3 + k] * vertexStrideFloat + j];
+            }
+            centroids[triangle * 3 + j] = sum / 3.f;
+        }
+    });
+
+    // every level splits all partitions that are still too large at once, the partitions of a level are independent
+    std::vector<Partition> partitions(1, Partition{ 0, triangleCount });
+
+    while (std::any_of(partitions.begin(), partitions.end(), [&](const Partition& partition) { return partition.count > partitionTriangles; }))
+    {
+        std::vector<Partition> halves(partitions.size() * 2);
+
+        std::vector<size_t> jobs(partitions.size());
+        for (size_t i = 0; i < jobs.size(); ++i)
+        {
+            jobs[i] = i;
+        }
+
+        std::for_each(std::execution::par, jobs.begin(), jobs.end(), [&](size_t job)
+        {
+            splitPartition(order, centroids, partitions[job], partitionTriangles, &halves[job * 2]);
+        });
+
+        halves.erase(std::remove_if(halves.begin(), halves.end(), [](const Partition& partition) { return partition.count == 0; }), halves.end());
+        partitions.swap(halves);
+    }
+
+    std::vector<PartitionMeshlets> results(partitions.size());
+
+    std::vector<size_t> jobs(partitions.size());
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        jobs[i] = i;
+    }
+
+    // nth_element leaves the triangles of a partition in an implementation defined order, sorting them makes the meshlets deterministic
+    std::for_each(std::execution::par, jobs.begin(), jobs.end(), [&](size_t job)
+    {
+        const Partition& partition = partitions[job];
+        std::sort(order.begin() + partition.offset, order.begin() + partition.offset + partition.count);
+
+        buildPartitionMeshlets(results[job], order, partition, indices, vertexPositions, vertexPositionsStride, maxVertices, maxTriangles, coneWeight);
+    });
+
+    // partitions follow the split order, so consecutive meshlets stay spatially close like the ones of meshopt
+    meshlets.clear();
+    meshletVertices.clear();
+    meshletTriangles.clear();
+
+    for (const PartitionMeshlets& result : results)
+    {
+        uint32_t vertexOffset = uint32_t(meshletVertices.size());
+        uint32_t triangleOffset = uint32_t(meshletTriangles.size());
+
+        for (meshopt_Meshlet meshlet : result.meshlets)
+        {
+            meshlet.vertex_offset += vertexOffset;
+            meshlet.triangle_offset += triangleOffset;
+            meshlets.push_back(meshlet);
+        }
+
+        meshletVertices.insert(meshletVertices.end(), result.vertices.begin(), result.vertices.end());
+        meshletTriangles.insert(meshletTriangles.end(), result.triangles.begin(), result.triangles.end());
+    }
+
+    return meshlets.size();
+}
@@ -0,0 +1,14 @@
+#ifndef NIAGARA_MESHLET_BUILDER
+#define NIAGARA_MESHLET_BUILDER
+
+#include "niagara_prereq.h"
+#include "MeshOptimizer/meshoptimizer.h"
+
+// meshopt_buildMeshlets over spatial partitions of the triangles: centroids are split at the median of the longest axis until every
+// partition has at most partitionTriangles triangles, partitions are clusterized in parallel on their own compacted vertices and
+// the meshlets are concatenated in partition order; meshes that fit one partition get exactly the meshlets of meshopt_buildMeshlets
+size_t buildMeshletsParallel(std::vector<meshopt_Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint8_t>& meshletTriangles,
+    const uint32_t* indices, size_t indexCount, const float* vertexPositions, size_t vertexCount, size_t vertexPositionsStride,
+    size_t maxVertices, size_t maxTriangles, float coneWeight, size_t partitionTriangles);
+
+#endif
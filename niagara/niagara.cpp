@@ -1,10 +1,38 @@
 #include "app.h"
 
-int main() {
+int main(int argc, char** argv) {
     renderApplication app;
 
     try {
-        app.run();
+        // niagara --asset-report [path] analyzes the meshes on the cpu and exits
+        if (argc > 1 && strcmp(argv[1], "--asset-report") == 0)
+        {
+            app.writeAssetReport(argc > 2 ? argv[2] : "niagara_assets.json");
+        }
+        // niagara --overdraw-benchmark times the parallel overdraw analyzer against meshopt on kitten and dragon
+        else if (argc > 1 && strcmp(argv[1], "--overdraw-benchmark") == 0)
+        {
+            app.runOverdrawBenchmark();
+        }
+        // niagara --bvh-refit-benchmark times draw bvh refits with 1%, 10% and 100% of the draws moving
+        else if (argc > 1 && strcmp(argv[1], "--bvh-refit-benchmark") == 0)
+        {
+            app.runBvhRefitBenchmark();
+        }
+        // niagara --cluster-dag-verify builds the cluster dags of kitten and dragon twice and checks them for determinism and cracks
+        else if (argc > 1 && strcmp(argv[1], "--cluster-dag-verify") == 0)
+        {
+            app.runClusterDagVerify();
+        }
+        // niagara --meshlet-benchmark compares the meshlet strategies on kitten and dragon by build time, fill and cone culling
+        else if (argc > 1 && strcmp(argv[1], "--meshlet-benchmark") == 0)
+        {
+            app.runMeshletBenchmark();
+        }
+        else
+        {
+            app.run();
+        }
     }
     catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
@@ -24,6 +24,7 @@
 #include <optional>
 #include <set>
 #include <execution>
+#include <future>
 #include <array>
 #include <unordered_map>
 
@@ -0,0 +1,371 @@
+#include "overdraw_analyzer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cstring>
+#include <execution>
+#include <memory>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OVERDRAW_SIMD 1
+#else
+#define OVERDRAW_SIMD 0
+#endif
+
+// the viewport, triangle setup and fill rules follow meshopt's overdrawanalyzer.cpp exactly
+// every pixel still sees its triangles in index order with the same float depth sequence, so bands can't change the result
+namespace
+{
+
+const int kViewport = 256;
+const int kBandRows = 16;
+const int kBandCount = kViewport / kBandRows;
+
+// rows are padded so that the last 4 wide group of a row stays inside the buffer
+const int kStride = kViewport + 4;
+
+struct BandBuffer
+{
+    float z[2][kBandRows][kStride];
+    unsigned int overdraw[2][kBandRows][kStride];
+};
+
+struct TriangleSetup
+{
+    int sign;
+    int minx, maxx, miny, maxy;
+
+    int DX12, DX23, DX31;
+    int DY12, DY23, DY31;
+    int CY1, CY2, CY3;
+
+    float DZx, DZy;
+    float ZY;
+};
+
+// kept verbatim, including the operator precedence, to produce the same gradients
+float computeDepthGradients(float& dzdx, float& dzdy, float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3, float z3)
+{
+    float det = (x2 - x1) * (y3 - y1) - (y2 - y1) * (x3 - x1);
+    float invdet = (det == 0) ? 0 : 1 / det;
+
+    dzdx = (z2 - z1) * (y3 - y1) - (y2 - y1) * (z3 - z1) * invdet;
+    dzdy = (x2 - x1) * (z3 - z1) - (z2 - z1) * (x3 - x1) * invdet;
+
+    return det;
+}
+
+void setupTriangle(TriangleSetup& t, float v1x, float v1y, float v1z, float v2x, float v2y, float v2z, float v3x, float v3y, float v3z)
+{
+    float det = computeDepthGradients(t.DZx, t.DZy, v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z);
+    t.sign = det > 0;
+
+    // backfacing triangles are flipped and go to the second buffer with reversed depth
+    if (t.sign)
+    {
+        std::swap(v2x, v3x);
+        std::swap(v2y, v3y);
+        std::swap(v2z, v3z);
+
+        v1z = kViewport - v1z;
+        t.DZx = -t.DZx;
+        t.DZy = -t.DZy;
+    }
+
+    // 28.4 fixed point
+    int X1 = int(16.0f * v1x + 0.5f);
+    int X2 = int(16.0f * v2x + 0.5f);
+    int X3 = int(16.0f * v3x + 0.5f);
+
+    int Y1 = int(16.0f * v1y + 0.5f);
+    int Y2 = int(16.0f * v2y + 0.5f);
+    int Y3 = int(16.0f * v3y + 0.5f);
+
+    t.minx = std::max((std::min(X1, std::min(X2, X3)) + 7) >> 4, 0);
+    t.maxx = std::min((std::max(X1, std::max(X2, X3)) + 7) >> 4, kViewport);
+    t.miny = std::max((std::min(Y1, std::min(Y2, Y3)) + 7) >> 4, 0);
+    t.maxy = std::min((std::max(Y1, std::max(Y2, Y3)) + 7) >> 4, kViewport);
+
+    t.DX12 = X1 - X2;
+    t.DX23 = X2 - X3;
+    t.DX31 = X3 - X1;
+
+    t.DY12 = Y1 - Y2;
+    t.DY23 = Y2 - Y3;
+    t.DY31 = Y3 - Y1;
+
+    // top-left fill convention
+    int TL1 = t.DY12 < 0 || (t.DY12 == 0 && t.DX12 > 0);
+    int TL2 = t.DY23 < 0 || (t.DY23 == 0 && t.DX23 > 0);
+    int TL3 = t.DY31 < 0 || (t.DY31 == 0 && t.DX31 > 0);
+
+    int FX = (t.minx << 4) + 8;
+    int FY = (t.miny << 4) + 8;
+    t.CY1 = t.DX12 * (FY - Y1) - t.DY12 * (FX - X1) + TL1 - 1;
+    t.CY2 = t.DX23 * (FY - Y2) - t.DY23 * (FX - X2) + TL2 - 1;
+    t.CY3 = t.DX31 * (FY - Y3) - t.DY31 * (FX - X3) + TL3 - 1;
+    t.ZY = v1z + (t.DZx * float(FX - X1) + t.DZy * float(FY - Y1)) * (1 / 16.f);
+}
+
+void setupTriangle(TriangleSetup& t, const float* triangles, size_t triangle, int axis)
+{
+    const float* v0 = &triangles[9 * triangle + 0];
+    const float* v1 = &triangles[9 * triangle + 3];
+    const float* v2 = &triangles[9 * triangle + 6];
+
+    switch (axis)
+    {
+    case 0:
+        setupTriangle(t, v0[2], v0[1], v0[0], v1[2], v1[1], v1[0], v2[2], v2[1], v2[0]);
+        break;
+    case 1:
+        setupTriangle(t, v0[0], v0[2], v0[1], v1[0], v1[2], v1[1], v2[0], v2[2], v2[1]);
+        break;
+    default:
+        setupTriangle(t, v0[1], v0[0], v0[2], v1[1], v1[0], v1[2], v2[1], v2[0], v2[2]);
+        break;
+    }
+}
+
+// the bounding rectangle of setupTriangle without the depth setup, the backface swap doesn't change it
+bool triangleRows(const float* triangles, size_t triangle, int axis, int& miny, int& maxy)
+{
+    const int xs[3] = { 2, 0, 1 };
+    const int ys[3] = { 1, 2, 0 };
+
+    int X[3], Y[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        X[k] = int(16.0f * triangles[9 * triangle + 3 * k + xs[axis]] + 0.5f);
+        Y[k] = int(16.0f * triangles[9 * triangle + 3 * k + ys[axis]] + 0.5f);
+    }
+
+    int minx = std::max((std::min(X[0], std::min(X[1], X[2])) + 7) >> 4, 0);
+    int maxx = std::min((std::max(X[0], std::max(X[1], X[2])) + 7) >> 4, kViewport);
+    miny = std::max((std::min(Y[0], std::min(Y[1], Y[2])) + 7) >> 4, 0);
+    maxy = std::min((std::max(Y[0], std::max(Y[1], Y[2])) + 7) >> 4, kViewport);
+
+    return minx < maxx && miny < maxy;
+}
+
+void rasterizeBand(BandBuffer& buffer, int bandY, const TriangleSetup& t)
+{
+    int y0 = std::max(t.miny, bandY);
+    int y1 = std::min(t.maxy, bandY + kBandRows);
+
+    // step the row equations to the first row of the band the same way the row loop does
+    int CY1 = int(unsigned(t.CY1) + (unsigned(t.DX12) << 4) * unsigned(y0 - t.miny));
+    int CY2 = int(unsigned(t.CY2) + (unsigned(t.DX23) << 4) * unsigned(y0 - t.miny));
+    int CY3 = int(unsigned(t.CY3) + (unsigned(t.DX31) << 4) * unsigned(y0 - t.miny));
+    float ZY = t.ZY;
+
+    for (int y = t.miny; y < y0; ++y)
+    {
+        ZY += t.DZy;
+    }
+
+    for (int y = y0; y < y1; ++y)
+    {
+        float* zrow = buffer.z[t.sign][y - bandY];
+        unsigned int* overdrawRow = buffer.overdraw[t.sign][y - bandY];
+
+        float ZX = ZY;
+
+#if OVERDRAW_SIMD
+        unsigned int step1 = unsigned(t.DY12) << 4;
+        unsigned int step2 = unsigned(t.DY23) << 4;
+        unsigned int step3 = unsigned(t.DY31) << 4;
+
+        __m128i CX1 = _mm_setr_epi32(CY1, int(unsigned(CY1) - step1), int(unsigned(CY1) - step1 * 2), int(unsigned(CY1) - step1 * 3));
+        __m128i CX2 = _mm_setr_epi32(CY2, int(unsigned(CY2) - step2), int(unsigned(CY2) - step2 * 2), int(unsigned(CY2) - step2 * 3));
+        __m128i CX3 = _mm_setr_epi32(CY3, int(unsigned(CY3) - step3), int(unsigned(CY3) - step3 * 2), int(unsigned(CY3) - step3 * 3));
+
+        __m128i groupStep1 = _mm_set1_epi32(int(step1 * 4));
+        __m128i groupStep2 = _mm_set1_epi32(int(step2 * 4));
+        __m128i groupStep3 = _mm_set1_epi32(int(step3 * 4));
+
+        __m128i maxx = _mm_set1_epi32(t.maxx);
+        __m128i lane = _mm_setr_epi32(t.minx, t.minx + 1, t.minx + 2, t.minx + 3);
+
+        for (int x = t.minx; x < t.maxx; x += 4)
+        {
+            // depth is still accumulated one pixel at a time to match the scalar rounding
+            float z0 = ZX;
+            float z1 = z0 + t.DZx;
+            float z2 = z1 + t.DZx;
+            float z3 = z2 + t.DZx;
+            ZX = z3 + t.DZx;
+
+            __m128 depth = _mm_setr_ps(z0, z1, z2, z3);
+            __m128 previous = _mm_loadu_ps(zrow + x);
+
+            __m128i inside = _mm_cmpgt_epi32(_mm_or_si128(_mm_or_si128(CX1, CX2), CX3), _mm_set1_epi32(-1));
+            __m128i pass = _mm_and_si128(_mm_and_si128(inside, _mm_cmplt_epi32(lane, maxx)), _mm_castps_si128(_mm_cmpge_ps(depth, previous)));
+            __m128 passf = _mm_castsi128_ps(pass);
+
+            _mm_storeu_ps(zrow + x, _mm_or_ps(_mm_and_ps(passf, depth), _mm_andnot_ps(passf, previous)));
+
+            // pass lanes are all ones, subtracting them increments the counters
+            __m128i overdraw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(overdrawRow + x));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(overdrawRow + x), _mm_sub_epi32(overdraw, pass));
+
+            CX1 = _mm_sub_epi32(CX1, groupStep1);
+            CX2 = _mm_sub_epi32(CX2, groupStep2);
+            CX3 = _mm_sub_epi32(CX3, groupStep3);
+            lane = _mm_add_epi32(lane, _mm_set1_epi32(4));
+        }
+#else
+        int CX1 = CY1;
+        int CX2 = CY2;
+        int CX3 = CY3;
+
+        for (int x = t.minx; x < t.maxx; x++)
+        {
+            if ((CX1 | CX2 | CX3) >= 0)
+            {
+                if (ZX >= zrow[x])
+                {
+                    zrow[x] = ZX;
+                    overdrawRow[x]++;
+                }
+            }
+
+            CX1 -= int(unsigned(t.DY12) << 4);
+            CX2 -= int(unsigned(t.DY23) << 4);
+            CX3 -= int(unsigned(t.DY31) << 4);
+            ZX += t.DZx;
+        }
+#endif
+
+        CY1 += int(unsigned(t.DX12) << 4);
+        CY2 += int(unsigned(t.DX23) << 4);
+        CY3 += int(unsigned(t.DX31) << 4);
+        ZY += t.DZy;
+    }
+}
+
+struct BandResult
+{
+    unsigned int pixelsCovered;
+    unsigned int pixelsShaded;
+};
+
+} // namespace
+
+meshopt_OverdrawStatistics analyzeOverdrawParallel(const unsigned int* indices, size_t index_count, const float* vertex_positions, size_t vertex_count, size_t vertex_positions_stride)
+{
+    assert(index_count % 3 == 0);
+    assert(vertex_positions_stride >= 12 && vertex_positions_stride <= 256);
+    assert(vertex_positions_stride % sizeof(float) == 0);
+
+    size_t vertex_stride_float = vertex_positions_stride / sizeof(float);
+    size_t triangle_count = index_count / 3;
+
+    meshopt_OverdrawStatistics result = {};
+
+    // the same normalization as meshopt, including how its min/max macros treat nan
+    float minv[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float maxv[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    for (size_t i = 0; i < vertex_count; ++i)
+    {
+        const float* v = vertex_positions + i * vertex_stride_float;
+
+        for (int j = 0; j < 3; ++j)
+        {
+            minv[j] = minv[j] < v[j] ? minv[j] : v[j];
+            maxv[j] = maxv[j] > v[j] ? maxv[j] : v[j];
+        }
+    }
+
+    float extentyz = (maxv[1] - minv[1]) > (maxv[2] - minv[2]) ? (maxv[1] - minv[1]) : (maxv[2] - minv[2]);
+    float extent = (maxv[0] - minv[0]) > extentyz ? (maxv[0] - minv[0]) : extentyz;
+    float scale = kViewport / extent;
+
+    std::vector<float> triangles(index_count * 3);
+
+    for (size_t i = 0; i < index_count; ++i)
+    {
+        unsigned int index = indices[i];
+        assert(index < vertex_count);
+
+        const float* v = vertex_positions + index * vertex_stride_float;
+
+        triangles[i * 3 + 0] = (v[0] - minv[0]) * scale;
+        triangles[i * 3 + 1] = (v[1] - minv[1]) * scale;
+        triangles[i * 3 + 2] = (v[2] - minv[2]) * scale;
+    }
+
+    // bins keep index order, which keeps the per pixel depth test order of the scalar analyzer
+    std::vector<uint32_t> bins[3][kBandCount];
+
+    int axes[3] = { 0, 1, 2 };
+    std::for_each(std::execution::par, axes, axes + 3, [&](int axis)
+    {
+        for (size_t i = 0; i < triangle_count; ++i)
+        {
+            int miny, maxy;
+            if (!triangleRows(triangles.data(), i, axis, miny, maxy))
+            {
+                continue;
+            }
+
+            for (int band = miny / kBandRows; band <= (maxy - 1) / kBandRows; ++band)
+            {
+                bins[axis][band].push_back(uint32_t(i));
+            }
+        }
+    });
+
+    std::vector<int> jobs(3 * kBandCount);
+    for (int i = 0; i < int(jobs.size()); ++i)
+    {
+        jobs[i] = i;
+    }
+
+    std::vector<BandResult> results(jobs.size());
+
+    std::for_each(std::execution::par, jobs.begin(), jobs.end(), [&](int job)
+    {
+        int axis = job / kBandCount;
+        int band = job % kBandCount;
+
+        std::unique_ptr<BandBuffer> buffer(new BandBuffer());
+
+        for (uint32_t triangle : bins[axis][band])
+        {
+            TriangleSetup t;
+            setupTriangle(t, triangles.data(), triangle, axis);
+
+            rasterizeBand(*buffer, band * kBandRows, t);
+        }
+
+        BandResult bandResult = {};
+
+        for (int y = 0; y < kBandRows; ++y)
+            for (int x = 0; x < kViewport; ++x)
+                for (int s = 0; s < 2; ++s)
+                {
+                    unsigned int overdraw = buffer->overdraw[s][y][x];
+
+                    bandResult.pixelsCovered += overdraw > 0;
+                    bandResult.pixelsShaded += overdraw;
+                }
+
+        results[job] = bandResult;
+    });
+
+    // integer sums, so the merge order can't change the result
+    for (const BandResult& bandResult : results)
+    {
+        result.pixels_covered += bandResult.pixelsCovered;
+        result.pixels_shaded += bandResult.pixelsShaded;
+    }
+
+    result.overdraw = result.pixels_covered ? float(result.pixels_shaded) / float(result.pixels_covered) : 0.f;
+
+    return result;
+}
@@ -0,0 +1,12 @@
+#ifndef NIAGARA_OVERDRAW_ANALYZER
+#define NIAGARA_OVERDRAW_ANALYZER
+
+#include <cstddef>
+
+#include "MeshOptimizer/meshoptimizer.h"
+
+// drop-in replacement for meshopt_analyzeOverdraw with bit-identical results
+// the three axis views are split into row bands that are rasterized in parallel, 4 pixels at a time
+meshopt_OverdrawStatistics analyzeOverdrawParallel(const unsigned int* indices, size_t index_count, const float* vertex_positions, size_t vertex_count, size_t vertex_positions_stride);
+
+#endif
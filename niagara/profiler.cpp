@@ -0,0 +1,279 @@
+#include "profiler.h"
+#include "common_helper.h"
+
+void RollingStatistics::add(double value)
+{
+    samples[head] = value;
+    head = (head + 1) % STATISTICSWINDOW;
+    sampleCount = std::min(sampleCount + 1, uint32_t(STATISTICSWINDOW));
+}
+
+void RollingStatistics::reset()
+{
+    sampleCount = 0;
+    head = 0;
+}
+
+double RollingStatistics::last() const
+{
+    return sampleCount ? samples[(head + STATISTICSWINDOW - 1) % STATISTICSWINDOW] : 0.0;
+}
+
+double RollingStatistics::average() const
+{
+    if (sampleCount == 0)
+    {
+        return 0.0;
+    }
+
+    double sum = 0.0;
+    for (uint32_t i = 0; i < sampleCount; ++i)
+    {
+        sum += samples[i];
+    }
+    return sum / sampleCount;
+}
+
+double RollingStatistics::minimum() const
+{
+    if (sampleCount == 0)
+    {
+        return 0.0;
+    }
+
+    double result = samples[0];
+    for (uint32_t i = 1; i < sampleCount; ++i)
+    {
+        result = std::min(result, samples[i]);
+    }
+    return result;
+}
+
+double RollingStatistics::maximum() const
+{
+    if (sampleCount == 0)
+    {
+        return 0.0;
+    }
+
+    double result = samples[0];
+    for (uint32_t i = 1; i < sampleCount; ++i)
+    {
+        result = std::max(result, samples[i]);
+    }
+    return result;
+}
+
+bool readTimestampSlice(VkDevice device, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount, uint64_t* outTimestamps)
+{
+    assert(queryCount <= QUERYCOUNT);
+
+    uint64_t results[QUERYCOUNT * 2];
+
+    // no VK_QUERY_RESULT_WAIT_BIT: the caller has already waited on the fence of the frame that wrote this slice
+    VkResult result = vkGetQueryPoolResults(device, queryPool, firstQuery, queryCount, sizeof(uint64_t) * 2 * queryCount, results, sizeof(uint64_t) * 2,
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    if (result != VK_SUCCESS && result != VK_NOT_READY)
+    {
+        throw std::runtime_error("failed to read query pool results!");
+    }
+
+    for (uint32_t i = 0; i < queryCount; ++i)
+    {
+        if (results[i * 2 + 1] == 0)
+        {
+            return false;
+        }
+        outTimestamps[i] = results[i * 2];
+    }
+
+    return true;
+}
+
+void ProfileTrace::beginCapture(uint32_t frameCount, const char* path)
+{
+    events.clear();
+    framesLeft = frameCount;
+    outputPath = path;
+}
+
+void ProfileTrace::addEvent(const char* name, uint32_t track, double begin, double end)
+{
+    if (isCapturing())
+    {
+        events.push_back({ name, track, begin, end });
+    }
+}
+
+void ProfileTrace::endFrame()
+{
+    if (!isCapturing())
+    {
+        return;
+    }
+
+    if (--framesLeft == 0)
+    {
+        write();
+        events.clear();
+    }
+}
+
+void ProfileTrace::write() const
+{
+    std::ofstream file(outputPath);
+
+    if (!file.is_open())
+    {
+        throw std::runtime_error("failed to open trace file!");
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << TRACE_TRACK_CPU << ",\"args\":{\"name\":\"CPU\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << TRACE_TRACK_GPU << ",\"args\":{\"name\":\"GPU\"}}";
+
+    char line[256];
+    for (const TraceEvent& event : events)
+    {
+        // chrome tracing expects microseconds
+        snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            event.name, event.track, event.begin * 1e3, (event.end - event.begin) * 1e3);
+        file << line;
+    }
+
+    file << "\n]}\n";
+
+    std::cout << "profile trace written to " << outputPath << std::endl;
+}
+
+void GpuProfiler::create(VkDevice device, uint32_t frameCount, float inTimestampPeriod)
+{
+    queryPool = createGenericQueryPool(device, QUERYCOUNT * frameCount, VK_QUERY_TYPE_TIMESTAMP);
+    timestampPeriod = inTimestampPeriod;
+    slices.resize(frameCount);
+}
+
+void GpuProfiler::destroy(VkDevice device)
+{
+    vkDestroyQueryPool(device, queryPool, nullptr);
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex, double cpuTime)
+{
+    FrameSlice& slice = slices[frameIndex];
+    slice.scopes.clear();
+    slice.queryCount = 0;
+    slice.cpuTime = cpuTime;
+    slice.pending = true;
+
+    currentSlice = frameIndex;
+    recording = true;
+    openScopes.clear();
+
+    vkCmdResetQueryPool(commandBuffer, queryPool, frameIndex * QUERYCOUNT, QUERYCOUNT);
+
+    beginScope(commandBuffer, "frame");
+}
+
+void GpuProfiler::endFrame(VkCommandBuffer commandBuffer)
+{
+    if (!recording)
+    {
+        return;
+    }
+
+    while (!openScopes.empty())
+    {
+        endScope(commandBuffer);
+    }
+
+    recording = false;
+}
+
+void GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name)
+{
+    if (!recording)
+    {
+        return;
+    }
+
+    FrameSlice& slice = slices[currentSlice];
+
+    // out of timestamps: the scope is skipped but still pushed so that endScope stays balanced
+    if (slice.queryCount + 2 > QUERYCOUNT)
+    {
+        openScopes.push_back(~0u);
+        return;
+    }
+
+    Scope scope = { name, slice.queryCount, slice.queryCount + 1 };
+    slice.queryCount += 2;
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, currentSlice * QUERYCOUNT + scope.beginQuery);
+
+    openScopes.push_back(uint32_t(slice.scopes.size()));
+    slice.scopes.push_back(scope);
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer)
+{
+    if (!recording)
+    {
+        return;
+    }
+
+    assert(!openScopes.empty());
+
+    uint32_t scopeIndex = openScopes.back();
+    openScopes.pop_back();
+
+    if (scopeIndex == ~0u)
+    {
+        return;
+    }
+
+    const Scope& scope = slices[currentSlice].scopes[scopeIndex];
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, currentSlice * QUERYCOUNT + scope.endQuery);
+}
+
+bool GpuProfiler::collect(VkDevice device, uint32_t frameIndex, ProfileTrace& trace)
+{
+    FrameSlice& slice = slices[frameIndex];
+
+    if (!slice.pending || slice.queryCount == 0)
+    {
+        return false;
+    }
+
+    uint64_t timestamps[QUERYCOUNT];
+
+    if (!readTimestampSlice(device, queryPool, frameIndex * QUERYCOUNT, slice.queryCount, timestamps))
+    {
+        return false;
+    }
+
+    slice.pending = false;
+
+    // the root scope is always the first one, everything else is placed relative to it
+    uint64_t frameBegin = timestamps[slice.scopes[0].beginQuery];
+    double tickToMs = double(timestampPeriod) * 1e-6;
+
+    for (const Scope& scope : slice.scopes)
+    {
+        double begin = double(timestamps[scope.beginQuery] - frameBegin) * tickToMs;
+        double end = double(timestamps[scope.endQuery] - frameBegin) * tickToMs;
+
+        statistics[scope.name].add(end - begin);
+        trace.addEvent(scope.name, TRACE_TRACK_GPU, slice.cpuTime + begin, slice.cpuTime + end);
+    }
+
+    return true;
+}
+
+const RollingStatistics* GpuProfiler::getStatistics(const char* name) const
+{
+    auto it = statistics.find(name);
+    return it == statistics.end() ? nullptr : &it->second;
+}
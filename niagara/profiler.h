@@ -0,0 +1,144 @@
+#ifndef NIAGARA_PROFILER
+#define NIAGARA_PROFILER
+
+#include "niagara_prereq.h"
+
+#define STATISTICSWINDOW 128
+
+// keeps the last STATISTICSWINDOW samples of a value so that averages don't lag behind like an exponential filter
+struct RollingStatistics
+{
+    double samples[STATISTICSWINDOW] = {};
+    uint32_t sampleCount = 0;
+    uint32_t head = 0;
+
+    void add(double value);
+    void reset();
+
+    double last() const;
+    double average() const;
+    double minimum() const;
+    double maximum() const;
+};
+
+// reads back one frame-in-flight slice of a timestamp query pool without waiting on the gpu
+// results are written as (value, availability) pairs; returns false if any query of the range is not available yet
+bool readTimestampSlice(VkDevice device, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount, uint64_t* outTimestamps);
+
+enum TraceTrack
+{
+    TRACE_TRACK_CPU = 0,
+    TRACE_TRACK_GPU = 1,
+};
+
+struct TraceEvent
+{
+    const char* name; // scope names are string literals, so only the pointer is kept
+    uint32_t track;
+    double begin; // ms
+    double end; // ms
+};
+
+// collects cpu & gpu scopes for a number of frames and writes them as a chrome://tracing json file
+class ProfileTrace
+{
+public:
+    void beginCapture(uint32_t frameCount, const char* path);
+    bool isCapturing() const { return framesLeft > 0; }
+
+    void addEvent(const char* name, uint32_t track, double begin, double end);
+
+    // counts down the captured frames and writes the file once the last one has been recorded
+    void endFrame();
+
+private:
+    void write() const;
+
+    std::vector<TraceEvent> events;
+    uint32_t framesLeft = 0;
+    std::string outputPath;
+};
+
+// scopes allocate timestamp pairs from a QUERYCOUNT sized slice of the query pool, one slice per frame in flight
+class GpuProfiler
+{
+public:
+    void create(VkDevice device, uint32_t frameCount, float timestampPeriod);
+    void destroy(VkDevice device);
+
+    // opens the root "frame" scope; cpuTime (ms) is used to place the gpu scopes next to the cpu ones in a trace
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex, double cpuTime);
+    void endFrame(VkCommandBuffer commandBuffer);
+
+    void beginScope(VkCommandBuffer commandBuffer, const char* name);
+    void endScope(VkCommandBuffer commandBuffer);
+
+    // reads back the slice of a retired frame; returns false if it holds no new results
+    bool collect(VkDevice device, uint32_t frameIndex, ProfileTrace& trace);
+
+    // per scope name statistics in ms, or nullptr if the scope was never collected
+    const RollingStatistics* getStatistics(const char* name) const;
+
+    const std::unordered_map<std::string, RollingStatistics>& getAllStatistics() const { return statistics; }
+
+private:
+    struct Scope
+    {
+        const char* name;
+        uint32_t beginQuery;
+        uint32_t endQuery;
+    };
+
+    struct FrameSlice
+    {
+        std::vector<Scope> scopes;
+        uint32_t queryCount;
+        double cpuTime;
+        bool pending;
+    };
+
+    VkQueryPool queryPool = 0;
+    float timestampPeriod = 1.f;
+
+    std::vector<FrameSlice> slices;
+    uint32_t currentSlice = 0;
+    bool recording = false;
+
+    std::vector<uint32_t> openScopes;
+
+    std::unordered_map<std::string, RollingStatistics> statistics;
+};
+
+struct GpuScope
+{
+    GpuScope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name) : profiler(profiler), commandBuffer(commandBuffer)
+    {
+        profiler.beginScope(commandBuffer, name);
+    }
+
+    ~GpuScope()
+    {
+        profiler.endScope(commandBuffer);
+    }
+
+    GpuProfiler& profiler;
+    VkCommandBuffer commandBuffer;
+};
+
+struct CpuScope
+{
+    CpuScope(ProfileTrace& trace, const char* name) : trace(trace), name(name), begin(glfwGetTime() * 1000)
+    {
+    }
+
+    ~CpuScope()
+    {
+        trace.addEvent(name, TRACE_TRACK_CPU, begin, glfwGetTime() * 1000);
+    }
+
+    ProfileTrace& trace;
+    const char* name;
+    double begin;
+};
+
+#endif
@@ -0,0 +1,324 @@
+#include "scene.h"
+
+// the same 10 bit per axis Morton code as meshopt_spatialSortRemap, with the mesh index above it
+// sorted with a least significant digit radix sort: per chunk histograms and scatters run in parallel, the prefix sum between them is serial
+static const uint32_t kRadixBits = 11;
+static const uint32_t kRadixSize = 1 << kRadixBits;
+static const size_t kChunkSize = 64 * 1024;
+
+// "insert" two 0 bits after each of the 10 low bits of x
+static uint32_t part1By2(uint32_t x)
+{
+    x &= 0x000003ff;
+    x = (x ^ (x << 16)) & 0xff0000ff;
+    x = (x ^ (x << 8)) & 0x0300f00f;
+    x = (x ^ (x << 4)) & 0x030c30c3;
+    x = (x ^ (x << 2)) & 0x09249249;
+    return x;
+}
+
+// the jobs of a parallel loop are indices, so the body never derives them from element addresses
+template <typename Function>
+static void forEachIndex(size_t count, Function function)
+{
+    std::vector<size_t> jobs(count);
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        jobs[i] = i;
+    }
+
+    std::for_each(std::execution::par, jobs.begin(), jobs.end(), [&](size_t job)
+    {
+        function(job);
+    });
+}
+
+template <typename Function>
+static void forEachChunk(size_t count, Function function)
+{
+    std::vector<size_t> chunks((count + kChunkSize - 1) / kChunkSize);
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        chunks[i] = i;
+    }
+
+    std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](size_t chunk)
+    {
+        function(chunk, chunk * kChunkSize, std::min((chunk + 1) * kChunkSize, count));
+    });
+}
+
+void computeDrawOrder(const std::vector<MeshDraw>& draws, std::vector<uint32_t>& order)
+{
+    size_t count = draws.size();
+    order.resize(count);
+
+    if (count < 2)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            order[i] = uint32_t(i);
+        }
+        return;
+    }
+
+    size_t chunkCount = (count + kChunkSize - 1) / kChunkSize;
+
+    std::vector<glm::vec3> chunkMin(chunkCount, glm::vec3(std::numeric_limits<float>::max()));
+    std::vector<glm::vec3> chunkMax(chunkCount, glm::vec3(-std::numeric_limits<float>::max()));
+    std::vector<uint32_t> chunkMeshMax(chunkCount, 0);
+
+    forEachChunk(count, [&](size_t chunk, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            chunkMin[chunk] = glm::min(chunkMin[chunk], draws[i].position);
+            chunkMax[chunk] = glm::max(chunkMax[chunk], draws[i].position);
+            chunkMeshMax[chunk] = std::max(chunkMeshMax[chunk], draws[i].meshIndex);
+        }
+    });
+
+    glm::vec3 minv = chunkMin[0];
+    glm::vec3 maxv = chunkMax[0];
+    uint32_t meshMax = chunkMeshMax[0];
+    for (size_t chunk = 1; chunk < chunkCount; ++chunk)
+    {
+        minv = glm::min(minv, chunkMin[chunk]);
+        maxv = glm::max(maxv, chunkMax[chunk]);
+        meshMax = std::max(meshMax, chunkMeshMax[chunk]);
+    }
+
+    glm::vec3 size = maxv - minv;
+    float extent = std::max(size.x, std::max(size.y, size.z));
+    float scale = extent == 0.f ? 0.f : 1.f / extent;
+
+    std::vector<uint64_t> keys(count);
+
+    forEachChunk(count, [&](size_t chunk, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            glm::vec3 p = (draws[i].position - minv) * scale * 1023.f + 0.5f;
+            uint32_t morton = part1By2(uint32_t(p.x)) | (part1By2(uint32_t(p.y)) << 1) | (part1By2(uint32_t(p.z)) << 2);
+
+            keys[i] = (uint64_t(draws[i].meshIndex) << 30) | morton;
+            order[i] = uint32_t(i);
+        }
+    });
+
+    uint32_t keyBits = 30;
+    while (keyBits < 64 && (uint64_t(meshMax) >> (keyBits - 30)) != 0)
+    {
+        keyBits++;
+    }
+
+    std::vector<uint64_t> keysScratch(count);
+    std::vector<uint32_t> orderScratch(count);
+    std::vector<uint32_t> histograms(chunkCount * kRadixSize);
+
+    for (uint32_t shift = 0; shift < keyBits; shift += kRadixBits)
+    {
+        forEachChunk(count, [&](size_t chunk, size_t begin, size_t end)
+        {
+            uint32_t* histogram = &histograms[chunk * kRadixSize];
+            memset(histogram, 0, kRadixSize * sizeof(uint32_t));
+
+            for (size_t i = begin; i < end; ++i)
+            {
+                histogram[(keys[i] >> shift) & (kRadixSize - 1)]++;
+            }
+        });
+
+        // digit-major, chunk-minor offsets keep the sort stable
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < kRadixSize; ++digit)
+        {
+            for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+            {
+                uint32_t digitCount = histograms[chunk * kRadixSize + digit];
+                histograms[chunk * kRadixSize + digit] = offset;
+                offset += digitCount;
+            }
+        }
+
+        forEachChunk(count, [&](size_t chunk, size_t begin, size_t end)
+        {
+            uint32_t* histogram = &histograms[chunk * kRadixSize];
+
+            for (size_t i = begin; i < end; ++i)
+            {
+                uint32_t destination = histogram[(keys[i] >> shift) & (kRadixSize - 1)]++;
+                keysScratch[destination] = keys[i];
+                orderScratch[destination] = order[i];
+            }
+        });
+
+        keys.swap(keysScratch);
+        order.swap(orderScratch);
+    }
+}
+
+void sortDrawsSpatially(std::vector<MeshDraw>& draws)
+{
+    size_t count = draws.size();
+
+    std::vector<uint32_t> order;
+    computeDrawOrder(draws, order);
+
+    std::vector<MeshDraw> sorted(count);
+
+    forEachChunk(count, [&](size_t chunk, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            sorted[i] = draws[order[i]];
+        }
+    });
+
+    draws.swap(sorted);
+}
+
+static DrawBvhNode emptyBvhNode(size_t childOffset, size_t childCount)
+{
+    DrawBvhNode node = {};
+    node.boxMin = glm::vec3(std::numeric_limits<float>::max());
+    node.boxMax = glm::vec3(-std::numeric_limits<float>::max());
+    node.childOffset = uint32_t(childOffset);
+    node.childCount = uint32_t(childCount);
+    return node;
+}
+
+static double surfaceArea(const DrawBvhNode& node)
+{
+    glm::vec3 size = node.boxMax - node.boxMin;
+    return 2.0 * (double(size.x) * size.y + double(size.y) * size.z + double(size.z) * size.x);
+}
+
+// leaves contain the same world space spheres drawcmd.comp tests, so a rejected box never hides a draw that would pass
+static void fitLeaf(DrawBvhNode& leaf, const std::vector<uint32_t>& order, const std::vector<MeshDraw>& draws, const std::vector<MeshInstance>& meshes)
+{
+    leaf = emptyBvhNode(leaf.childOffset, leaf.childCount);
+
+    for (size_t i = leaf.childOffset; i < leaf.childOffset + leaf.childCount; ++i)
+    {
+        const MeshDraw& draw = draws[order[i]];
+        const MeshInstance& mesh = meshes[draw.meshIndex];
+
+        glm::vec3 center = draw.rotation * mesh.center * draw.scale + draw.position;
+        float radius = mesh.radius * draw.scale;
+
+        leaf.boxMin = glm::min(leaf.boxMin, center - radius);
+        leaf.boxMax = glm::max(leaf.boxMax, center + radius);
+    }
+}
+
+static void fitNode(DrawBvhNode& node, const std::vector<DrawBvhNode>& leaves)
+{
+    node = emptyBvhNode(node.childOffset, node.childCount);
+
+    for (size_t i = node.childOffset; i < node.childOffset + node.childCount; ++i)
+    {
+        node.boxMin = glm::min(node.boxMin, leaves[i].boxMin);
+        node.boxMax = glm::max(node.boxMax, leaves[i].boxMax);
+    }
+}
+
+void DrawBvh::build(const std::vector<MeshDraw>& draws, const std::vector<MeshInstance>& meshes)
+{
+    computeDrawOrder(draws, order);
+
+    leaves.resize((draws.size() + DRAW_BVH_WIDTH - 1) / DRAW_BVH_WIDTH);
+    nodes.resize((leaves.size() + DRAW_BVH_WIDTH - 1) / DRAW_BVH_WIDTH);
+    drawLeaves.resize(draws.size());
+
+    std::vector<double> areas(leaves.size());
+
+    forEachIndex(leaves.size(), [&](size_t index)
+    {
+        DrawBvhNode& leaf = leaves[index];
+        size_t first = index * DRAW_BVH_WIDTH;
+
+        leaf = emptyBvhNode(first, std::min(draws.size() - first, size_t(DRAW_BVH_WIDTH)));
+        fitLeaf(leaf, order, draws, meshes);
+        areas[index] = surfaceArea(leaf);
+
+        for (size_t i = first; i < first + leaf.childCount; ++i)
+        {
+            drawLeaves[order[i]] = uint32_t(index);
+        }
+    });
+
+    forEachIndex(nodes.size(), [&](size_t index)
+    {
+        DrawBvhNode& node = nodes[index];
+        size_t first = index * DRAW_BVH_WIDTH;
+
+        node = emptyBvhNode(first, std::min(leaves.size() - first, size_t(DRAW_BVH_WIDTH)));
+        fitNode(node, leaves);
+    });
+
+    leafArea = 0;
+    for (double area : areas)
+    {
+        leafArea += area;
+    }
+    builtLeafArea = leafArea;
+}
+
+void DrawBvh::refit(const std::vector<MeshDraw>& draws, const std::vector<MeshInstance>& meshes, const std::vector<uint32_t>& dirtyDraws, std::vector<uint32_t>& dirtyLeaves, std::vector<uint32_t>& dirtyNodes)
+{
+    dirtyLeaves.clear();
+    dirtyNodes.clear();
+
+    std::vector<uint8_t> leafDirty(leaves.size(), 0);
+
+    for (uint32_t draw : dirtyDraws)
+    {
+        uint32_t leaf = drawLeaves[draw];
+
+        if (!leafDirty[leaf])
+        {
+            leafDirty[leaf] = 1;
+            dirtyLeaves.push_back(leaf);
+        }
+    }
+
+    std::sort(dirtyLeaves.begin(), dirtyLeaves.end());
+
+    // leaves are refit from all of their draws, a union with the new spheres alone would never shrink
+    std::vector<double> areaDeltas(dirtyLeaves.size());
+
+    forEachIndex(dirtyLeaves.size(), [&](size_t index)
+    {
+        DrawBvhNode& leaf = leaves[dirtyLeaves[index]];
+
+        double oldArea = surfaceArea(leaf);
+        fitLeaf(leaf, order, draws, meshes);
+        areaDeltas[index] = surfaceArea(leaf) - oldArea;
+    });
+
+    for (double delta : areaDeltas)
+    {
+        leafArea += delta;
+    }
+
+    for (uint32_t leaf : dirtyLeaves)
+    {
+        uint32_t node = leaf / DRAW_BVH_WIDTH;
+
+        if (dirtyNodes.empty() || dirtyNodes.back() != node)
+        {
+            dirtyNodes.push_back(node);
+        }
+    }
+
+    std::for_each(std::execution::par, dirtyNodes.begin(), dirtyNodes.end(), [&](uint32_t node)
+    {
+        fitNode(nodes[node], leaves);
+    });
+}
+
+double DrawBvh::quality() const
+{
+    return builtLeafArea > 0 ? leafArea / builtLeafArea : 1.0;
+}
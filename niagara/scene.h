@@ -0,0 +1,36 @@
+#ifndef NIAGARA_SCENE
+#define NIAGARA_SCENE
+
+#include "niagara_prereq.h"
+#include "mesh.h"
+
+// order[i] is the draw at position i when draws of the same mesh are contiguous and follow a Morton curve through the scene
+void computeDrawOrder(const std::vector<MeshDraw>& draws, std::vector<uint32_t>& order);
+
+// reorders the draws by computeDrawOrder
+// culling threads then read neighbouring instances and the compacted command list comes out roughly front to back per region
+void sortDrawsSpatially(std::vector<MeshDraw>& draws);
+
+// cpu side of the two level draw bvh; leaves reference draws through order, so a rebuild never changes draw ids
+struct DrawBvh
+{
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> drawLeaves; // leaf of every draw
+    std::vector<DrawBvhNode> leaves;
+    std::vector<DrawBvhNode> nodes;
+
+    // summed leaf surface area; refits grow it as moving draws drift away from the neighbours they were sorted with
+    double leafArea = 0;
+    double builtLeafArea = 0;
+
+    // boxes the bounding spheres of the draws bottom up after sorting them with computeDrawOrder
+    void build(const std::vector<MeshDraw>& draws, const std::vector<MeshInstance>& meshes);
+
+    // refits the leaves holding the dirty draws and the nodes above them, which are returned in ascending order for uploading
+    void refit(const std::vector<MeshDraw>& draws, const std::vector<MeshInstance>& meshes, const std::vector<uint32_t>& dirtyDraws, std::vector<uint32_t>& dirtyLeaves, std::vector<uint32_t>& dirtyNodes);
+
+    // 1 right after a build, a rebuild pays off once this grows well past it
+    double quality() const;
+};
+
+#endif
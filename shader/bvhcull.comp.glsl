@@ -0,0 +1,120 @@
+#version 460
+
+#extension GL_EXT_shader_16bit_storage: require
+#extension GL_EXT_shader_8bit_storage: require
+#extension GL_EXT_shader_explicit_arithmetic_types: require
+
+#extension GL_GOOGLE_include_directive: require
+#extension GL_KHR_shader_subgroup_basic: require
+#extension GL_KHR_shader_subgroup_ballot: require
+
+#include "mesh_struct.h"
+
+// one workgroup per node, one thread per leaf of the node
+layout(local_size_x = DRAW_BVH_WIDTH, local_size_y = 1, local_size_z = 1) in;
+
+layout(push_constant) uniform block
+{
+    vec4 frustum[6];
+    int cullingEnabled;
+    int statisticsEnabled;
+};
+
+layout(binding = 0) buffer readonly Nodes
+{
+    DrawBvhNode nodes[];
+};
+
+layout(binding = 1) buffer readonly Leaves
+{
+    DrawBvhNode leaves[];
+};
+
+layout(binding = 2) buffer VisibleLeaves
+{
+    uint visibleLeafCount;
+    uint drawCullGroupCountX;
+    uint drawCullGroupCountY;
+    uint drawCullGroupCountZ;
+    uint visibleLeaves[];
+};
+
+layout(binding = 3) buffer Statistics
+{
+    CullStatistics stats;
+};
+
+// the corner furthest along each plane normal decides, a box is only rejected when it is entirely outside one plane
+bool boxVisible(vec3 boxMin, vec3 boxMax)
+{
+    bool visible = true;
+
+    for (int i = 0; i < 6; ++i)
+    {
+        vec3 corner = mix(boxMin, boxMax, greaterThanEqual(frustum[i].xyz, vec3(0)));
+        visible = visible && (dot(vec4(corner, 1), frustum[i]) > 0);
+    }
+
+    return visible;
+}
+
+void main()
+{
+    uint ni = gl_WorkGroupID.x;
+    uint ci = gl_LocalInvocationID.x;
+
+    DrawBvhNode node = nodes[ni];
+
+    // uniform across the workgroup, a rejected node skips all of its leaves and draws
+    bool nodeVisible = cullingEnabled == 1 ? boxVisible(node.boxMin, node.boxMax) : true;
+
+    if (statisticsEnabled == 1 && ci == 0)
+    {
+        atomicAdd(stats.nodesTested, 1);
+        atomicAdd(stats.nodesRejected, nodeVisible ? 0 : 1);
+    }
+
+    if (!nodeVisible || ci >= node.childCount)
+    {
+        return;
+    }
+
+    uint li = node.childOffset + ci;
+    DrawBvhNode leaf = leaves[li];
+
+    bool visible = cullingEnabled == 1 ? boxVisible(leaf.boxMin, leaf.boxMax) : true;
+
+    // one atomic per subgroup, the elected invocation is the first active one so its base can be broadcast
+    uvec4 ballot = subgroupBallot(visible);
+    uint visibleCount = subgroupBallotBitCount(ballot);
+    uint testedCount = subgroupBallotBitCount(subgroupBallot(true));
+    uint base = 0;
+
+    if (subgroupElect())
+    {
+        base = atomicAdd(visibleLeafCount, visibleCount);
+
+        if (visibleCount > 0)
+        {
+            // drawcmd.comp runs one workgroup per visible leaf, spilling into y past 65535 groups
+            uint leafEnd = base + visibleCount;
+
+            atomicMax(drawCullGroupCountX, min(leafEnd, 65535));
+            atomicMax(drawCullGroupCountY, (leafEnd - 1) / 65535 + 1);
+            atomicMax(drawCullGroupCountZ, 1);
+        }
+
+        if (statisticsEnabled == 1)
+        {
+            atomicAdd(stats.leavesTested, testedCount);
+            atomicAdd(stats.leavesRejected, testedCount - visibleCount);
+        }
+    }
+
+    base = subgroupBroadcastFirst(base);
+
+    if (visible)
+    {
+        visibleLeaves[base + subgroupBallotExclusiveBitCount(ballot)] = li;
+    }
+}
@@ -1,7 +1,17 @@
-glslc.exe --target-env=vulkan1.3 -fshader-stage=vert simple.vert.glsl -o ../compiledShader/simple.vert.spv
-glslc.exe --target-env=vulkan1.3 -fshader-stage=frag simple.frag.glsl -o ../compiledShader/simple.frag.spv
-glslc.exe --target-env=vulkan1.3 -fshader-stage=mesh meshlet.mesh.glsl -o ../compiledShader/meshlet.mesh.spv
-glslc.exe --target-env=vulkan1.3 -fshader-stage=task meshlet.task.glsl -o ../compiledShader/meshlet.task.spv
-glslc.exe --target-env=vulkan1.3 -fshader-stage=comp drawcmd.comp.glsl -o ../compiledShader/drawcmd.comp.spv
-glslc.exe --target-env=vulkan1.3 -fshader-stage=comp depthreduce.comp.glsl -o ../compiledShader/depthreduce.comp.spv
-pause
\ No newline at end of file
+glslc.exe --target-env=vulkan1.3 -fshader-stage=vert simple.vert.glsl -o ../compiledShader/simple.vert.spv || exit /b 1
+glslc.exe --target-env=vulkan1.3 -fshader-stage=frag simple.frag.glsl -o ../compiledShader/simple.frag.spv || exit /b 1
+glslc.exe --target-env=vulkan1.3 -fshader-stage=mesh meshlet.mesh.glsl -o ../compiledShader/meshlet.mesh.spv || exit /b 1
+glslc.exe --target-env=vulkan1.3 -fshader-stage=task meshlet.task.glsl -o ../compiledShader/meshlet.task.spv || exit /b 1
+glslc.exe --target-env=vulkan1.3 -fshader-stage=comp drawcmd.comp.glsl -o ../compiledShader/drawcmd.comp.spv || exit /b 1
+glslc.exe --target-env=vulkan1.3 -fshader-stage=comp depthreduce.comp.glsl -o ../compiledShader/depthreduce.comp.spv || exit /b 1
+glslc.exe --target-env=vulkan1.3 -fshader-stage=mesh meshlet_ext.mesh.glsl -o ../compiledShader/meshlet_ext.mesh.spv || exit /b 1
+glslc.exe --target-env=vulkan1.3 -fshader-stage=task meshlet_ext.task.glsl -o ../compiledShader/meshlet_ext.task.spv || exit /b 1
+glslc.exe --target-env=vulkan1.3 -fshader-stage=comp meshletcull.comp.glsl -o ../compiledShader/meshletcull.comp.spv || exit /b 1
+glslc.exe --target-env=vulkan1.3 -fshader-stage=frag visibility.frag.glsl -o ../compiledShader/visibility.frag.spv || exit /b 1
+glslc.exe --target-env=vulkan1.3 -fshader-stage=comp visresolve.comp.glsl -o ../compiledShader/visresolve.comp.spv || exit /b 1
+glslc.exe --target-env=vulkan1.3 -fshader-stage=vert depth.vert.glsl -o ../compiledShader/depth.vert.spv || exit /b 1
+glslc.exe --target-env=vulkan1.3 -fshader-stage=frag -DLOD_FADE=1 simple.frag.glsl -o ../compiledShader/simple_fade.frag.spv || exit /b 1
+glslc.exe --target-env=vulkan1.3 -fshader-stage=frag -DLOD_FADE=1 visibility.frag.glsl -o ../compiledShader/visibility_fade.frag.spv || exit /b 1
+glslc.exe --target-env=vulkan1.3 -fshader-stage=comp bvhcull.comp.glsl -o ../compiledShader/bvhcull.comp.spv || exit /b 1
+glslc.exe --target-env=vulkan1.3 -fshader-stage=comp scatter.comp.glsl -o ../compiledShader/scatter.comp.spv || exit /b 1
+if not "%1"=="nopause" pause
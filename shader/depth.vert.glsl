@@ -0,0 +1,47 @@
+#version 460
+
+#extension GL_EXT_shader_16bit_storage: require
+#extension GL_EXT_shader_8bit_storage: require
+#extension GL_EXT_shader_explicit_arithmetic_types: require
+
+#extension GL_ARB_shader_draw_parameters : require
+
+#extension GL_GOOGLE_include_directive: require
+
+#include "mesh_struct.h"
+
+layout(push_constant) uniform block
+{
+    Globals globals;
+};
+
+layout(binding = 0) buffer readonly DrawCommands
+{
+    MeshDrawCommand drawCommands[];
+};
+
+layout(binding = 1) buffer readonly Draws
+{
+    MeshDraw draws[];
+};
+
+layout(binding = 2) buffer readonly Positions
+{
+    u16vec4 positions[];
+};
+
+layout(binding = 3) buffer readonly Meshes
+{
+    MeshInstance meshes[];
+};
+
+// the color pass tests EQUAL against this depth, so both vertex shaders have to produce bit identical positions
+invariant gl_Position;
+
+void main() {
+    MeshDraw meshDraw = draws[drawCommands[gl_DrawIDARB].drawId];
+
+    vec3 inPosition = loadPosition(gl_VertexIndex, meshDraw.meshIndex);
+
+    gl_Position = globals.projection * vec4(rotate(inPosition, meshDraw.rotation) * meshDraw.scale + meshDraw.position, 1.0);
+}
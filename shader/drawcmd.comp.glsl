@@ -2,13 +2,17 @@
 
 #extension GL_EXT_shader_16bit_storage: require
 #extension GL_EXT_shader_8bit_storage: require
+#extension GL_EXT_shader_explicit_arithmetic_types: require
 
 #extension GL_GOOGLE_include_directive: require
+#extension GL_KHR_shader_subgroup_basic: require
 #extension GL_KHR_shader_subgroup_ballot: require
+#extension GL_KHR_shader_subgroup_arithmetic: require
 
 #include "mesh_struct.h"
 
-layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+// DRAW_BVH_WIDTH threads so that a workgroup covers one bvh leaf
+layout(local_size_x = DRAW_BVH_WIDTH, local_size_y = 1, local_size_z = 1) in;
 
 layout(push_constant) uniform block
 {
@@ -16,6 +20,11 @@ layout(push_constant) uniform block
     uint drawCount;
     int cullingEnabled;
     int lodEnabled;
+    int statisticsEnabled;
+    int meshletCullEnabled;
+    int lodFadeEnabled;
+    int bvhEnabled;
+    int clusterLodEnabled;
 };
 
 layout(binding = 0) buffer readonly Draws
@@ -36,13 +45,94 @@ layout(binding = 2) buffer writeonly DrawCommands
 layout(binding = 3) buffer DrawCommandCount
 {
     uint drawCommandCount;
+    uint meshletCullGroupCountX;
+    uint meshletCullGroupCountY;
+    uint meshletCullGroupCountZ;
+    uint meshletCullIndexCount;
 };
 
+layout(binding = 4) buffer Statistics
+{
+    CullStatistics stats;
+};
+
+layout(binding = 5) buffer LodStates
+{
+    DrawLodState lodStates[];
+};
+
+layout(binding = 6) buffer readonly Lods
+{
+    MeshLod lods[];
+};
+
+layout(binding = 7) buffer readonly Leaves
+{
+    DrawBvhNode leaves[];
+};
+
+layout(binding = 8) buffer readonly VisibleLeaves
+{
+    uint visibleLeafCount;
+    uint drawCullGroupCountX;
+    uint drawCullGroupCountY;
+    uint drawCullGroupCountZ;
+    uint visibleLeaves[];
+};
+
+layout(binding = 9) buffer readonly DrawOrder
+{
+    uint drawOrder[];
+};
+
+void writeDrawCommand(uint dci, uint di, uint vertexOffset, MeshLod lod, float lodFade)
+{
+    drawCommands[dci].drawId = di;
+    drawCommands[dci].indexCount = lod.indexCount;
+    drawCommands[dci].instanceCount = 1;
+    drawCommands[dci].firstIndex = lod.indexOffset;
+    drawCommands[dci].vertexOffset = vertexOffset;
+    drawCommands[dci].firstInstance = 0;
+
+    uint taskGroupCount = (lod.meshletCount + 31) / 32;
+
+    drawCommands[dci].taskCount = taskGroupCount;
+    drawCommands[dci].firstTask = 0;
+    // maxTaskWorkGroupCount is only guaranteed to be 65535 per dimension, large draws spill into y
+    drawCommands[dci].taskGroupCountX = min(taskGroupCount, 65535);
+    drawCommands[dci].taskGroupCountY = (taskGroupCount + 65534) / 65535;
+    drawCommands[dci].taskGroupCountZ = 1;
+
+    drawCommands[dci].meshletOffset = lod.meshletOffset;
+    drawCommands[dci].meshletCount = lod.meshletCount;
+    drawCommands[dci].lodFade = lodFade;
+}
+
 void main()
 {
     uint di = gl_GlobalInvocationID.x;
 
-    if (di >= drawCount)
+    if (bvhEnabled == 1)
+    {
+        // one workgroup per leaf that survived bvhcull.comp, see there for the y spill
+        uint vi = gl_WorkGroupID.x + gl_WorkGroupID.y * gl_NumWorkGroups.x;
+
+        if (vi >= visibleLeafCount)
+        {
+            return;
+        }
+
+        DrawBvhNode leaf = leaves[visibleLeaves[vi]];
+
+        if (gl_LocalInvocationID.x >= leaf.childCount)
+        {
+            return;
+        }
+
+        // leaves index the draws through the bvh order, rebuilds reorder it without changing draw ids
+        di = drawOrder[leaf.childOffset + gl_LocalInvocationID.x];
+    }
+    else if (di >= drawCount)
     {
         return;
     }
@@ -62,25 +152,108 @@ void main()
 
     visible = cullingEnabled == 1 ? visible : true;
 
-    if (visible)
+    if (statisticsEnabled == 1)
     {
-        uint dci = atomicAdd(drawCommandCount, 1);
+        // one atomic per subgroup instead of one per draw
+        uint testedCount = subgroupBallotBitCount(subgroupBallot(true));
+        uint visibleCount = subgroupBallotBitCount(subgroupBallot(visible));
 
+        if (subgroupElect())
+        {
+            atomicAdd(stats.drawsTested, testedCount);
+            atomicAdd(stats.drawsFrustumRejected, testedCount - visibleCount);
+            atomicAdd(stats.drawsVisible, visibleCount);
+        }
+    }
+
+    if (visible)
+    {
         float lodDistance = log2(max(1, (distance(center, vec3(0)) - radius)));
         
         uint lodIndex = clamp(int(lodDistance), 0, int(mesh.lodCount) - 1);
 
-        lodIndex = lodEnabled == 1 ? lodIndex : 0;
+        // a cluster dag replaces the lod chain, its cut is selected per meshlet and counts as lod 0 here
+        bool clusterLod = clusterLodEnabled == 1 && mesh.clusterCount > 0;
+
+        lodIndex = lodEnabled == 1 && !clusterLod ? lodIndex : 0;
+
+        DrawLodState state = lodStates[di];
+        uint stateLod = uint(state.lod);
+
+        uint previousLod = lodIndex;
+        float lodFade = 1.0;
+
+        if (lodFadeEnabled == 1 && !clusterLod && stateLod < mesh.lodCount)
+        {
+            // the current lod is kept until the distance leaves its band by LOD_HYSTERESIS, so draws sitting on a boundary don't flicker between lods
+            if (lodEnabled == 1 && lodDistance > float(stateLod) - LOD_HYSTERESIS && lodDistance < float(stateLod + 1) + LOD_HYSTERESIS)
+            {
+                lodIndex = stateLod;
+            }
+
+            if (lodIndex != stateLod)
+            {
+                state.previousLod = state.lod;
+                state.lod = uint8_t(lodIndex);
+                state.fadeFrames = uint8_t(LOD_FADE_FRAMES);
+            }
+
+            if (uint(state.fadeFrames) > 0)
+            {
+                // the new lod covers a growing share of the dither pattern, the old one the complement
+                previousLod = uint(state.previousLod);
+                lodFade = float(LOD_FADE_FRAMES + 1 - uint(state.fadeFrames)) / float(LOD_FADE_FRAMES + 1);
+                state.fadeFrames = uint8_t(uint(state.fadeFrames) - 1);
+            }
+        }
+        else
+        {
+            state.lod = uint8_t(lodIndex);
+            state.fadeFrames = uint8_t(0);
+        }
+
+        lodStates[di] = state;
+
+        uint commandCount = previousLod != lodIndex ? 2 : 1;
+        uint dci = atomicAdd(drawCommandCount, commandCount);
+
+        MeshLod lod = lods[mesh.lodOffset + lodIndex];
+
+        // any cut has at most the triangles of lod 0, so its index range still bounds the meshletcull.comp reservation and fallback
+        if (clusterLod)
+        {
+            lod.meshletOffset = mesh.clusterOffset;
+            lod.meshletCount = mesh.clusterCount;
+        }
+
+        writeDrawCommand(dci, di, mesh.vertexOffset, lod, lodFade);
+
+        if (commandCount == 2)
+        {
+            writeDrawCommand(dci + 1, di, mesh.vertexOffset, lods[mesh.lodOffset + previousLod], -lodFade);
+        }
+
+        if (statisticsEnabled == 1)
+        {
+            atomicAdd(stats.lodHistogram[lodIndex], 1);
+
+            if (commandCount == 2)
+            {
+                atomicAdd(stats.drawsLodFading, 1);
+            }
+        }
 
-        MeshLod lod = mesh.lods[lodIndex];
+        if (meshletCullEnabled == 1)
+        {
+            // meshletcull.comp runs one workgroup per draw command, spilling into y past 65535 groups
+            uint lastCommand = subgroupMax(dci + commandCount - 1);
 
-        drawCommands[dci].drawId = di;
-        drawCommands[dci].indexCount = lod.indexCount;
-        drawCommands[dci].instanceCount = 1;
-        drawCommands[dci].firstIndex = lod.indexOffset;
-        drawCommands[dci].vertexOffset = mesh.vertexOffset;
-        drawCommands[dci].firstInstance = 0;
-        drawCommands[dci].taskCount = (lod.meshletCount + 31) / 32;
-        drawCommands[dci].firstTask = lod.meshletOffset / 32;
+            if (subgroupElect())
+            {
+                atomicMax(meshletCullGroupCountX, min(lastCommand + 1, 65535));
+                atomicMax(meshletCullGroupCountY, lastCommand / 65535 + 1);
+                atomicMax(meshletCullGroupCountZ, 1);
+            }
+        }
     }
 }
\ No newline at end of file
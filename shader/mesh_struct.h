@@ -1,9 +1,21 @@
 #define MESHLETTRICOUNT 124
 
+// keep in sync with mesh.h
+#define MESHLET_SHORT_VERTICES 1
+
+// visibility buffer ids are uvec2(drawId, triangle); mesh shading encodes the triangle as (meshlet << 7) | local triangle
+#define VISIBILITY_TRIANGLE_BITS 7
+
+// frames a lod transition is dithered over, and how far in log2 distance a draw has to leave its lod band before switching
+#define LOD_FADE_FRAMES 15
+#define LOD_HYSTERESIS 0.1
+
+// positions are 16-bit unorm relative to the mesh bounds, the normal is octahedral 2x8-bit snorm
+// keep in sync with mesh.h
 struct Vertex
 {
-    float vx, vy, vz;
-    uint8_t nx, ny, nz, nw;
+    uint16_t px, py, pz;
+    int8_t nu, nv;
     float16_t tu, tv;
 };
 
@@ -16,14 +28,67 @@ struct Meshlet
     int8_t cone_axis[3];
     int8_t cone_cutoff;
 
-    uint dataOffset;
+    uint vertexBase;
+    uint vertexOffset;
+    uint triangleOffset;
 	uint8_t triangleCount; 
 	uint8_t vertexCount;
+	uint8_t wideVertices;
+};
+
+// parallel to the meshlets, see mesh.h
+struct MeshletLod
+{
+    vec3 center;
+    float radius;
+    vec3 parentCenter;
+    float parentRadius;
+    float error;
+    float parentError;
+};
+
+struct TaskPayload
+{
+    uint drawId;
+    float lodFade;
+    uint meshletIndices[32];
 };
 
 struct Globals
 {
     mat4 projection;
+    int statisticsEnabled;
+    float screenWidth;
+    float screenHeight;
+    float clusterLodThreshold;
+};
+
+// keep in sync with mesh.h
+#define MESH_MAX_LODS 8
+
+struct CullStatistics
+{
+    uint drawsTested;
+    uint drawsFrustumRejected;
+    uint drawsOcclusionRejected;
+    uint drawsVisible;
+    uint lodHistogram[MESH_MAX_LODS];
+
+    uint meshletsTested;
+    uint meshletsConeRejected;
+    uint meshletsFrustumRejected;
+
+    uint trianglesTested;
+    uint trianglesRejected;
+
+    uint drawsLodFading;
+
+    uint nodesTested;
+    uint nodesRejected;
+    uint leavesTested;
+    uint leavesRejected;
+
+    uint meshletsLodRejected;
 };
 
 struct MeshLod
@@ -32,6 +97,8 @@ struct MeshLod
 	uint indexCount;
     uint meshletOffset;
     uint meshletCount;
+
+    float error;
 };
 
 struct MeshInstance
@@ -39,12 +106,16 @@ struct MeshInstance
     vec3 center;
     float radius;
 
+    vec3 positionOffset;
     uint vertexOffset;
+    vec3 positionScale;
     uint vertexCount;
 
+    uint lodOffset;
     uint lodCount;
 
-    MeshLod lods[8];
+    uint clusterOffset;
+    uint clusterCount;
 };
 
 struct MeshDraw
@@ -68,9 +139,121 @@ struct MeshDrawCommand
     uint firstInstance;
     uint taskCount;
     uint firstTask;
+    uint taskGroupCountX;
+    uint taskGroupCountY;
+    uint taskGroupCountZ;
+    uint meshletOffset;
+    uint meshletCount;
+
+    float lodFade;
+};
+
+// keep in sync with mesh.h
+#define DRAW_BVH_WIDTH 64
+
+struct DrawBvhNode
+{
+    vec3 boxMin;
+    uint childOffset;
+    vec3 boxMax;
+    uint childCount;
 };
 
+// persistent per draw lod selection, lod is 0xff until the draw was first seen
+struct DrawLodState
+{
+    uint8_t lod;
+    uint8_t previousLod;
+    uint8_t fadeFrames;
+    uint8_t padding;
+};
+
+// mesh relative index of vertex i of a meshlet; expects the shader to declare the meshlet vertex stream as meshletVertices[]
+// wide meshlets store a low and a high half per index, see mesh.h
+#if MESHLET_SHORT_VERTICES
+#define meshletVertex(vertexBase, vertexOffset, i, wide) ((vertexBase) + ((wide) ? (uint(meshletVertices[(vertexOffset) + (i) * 2]) | (uint(meshletVertices[(vertexOffset) + (i) * 2 + 1]) << 16)) : uint(meshletVertices[(vertexOffset) + (i)])))
+#else
+#define meshletVertex(vertexBase, vertexOffset, i, wide) ((vertexBase) + meshletVertices[(vertexOffset) + (i)])
+#endif
+
 vec3 rotate(vec3 pos, vec4 q)
 {
     return pos + 2.0 * cross(q.xyz, cross(q.xyz, pos) + q.w * pos);
-}
\ No newline at end of file
+}
+
+vec3 dequantizePosition(u16vec4 q, vec3 offset, vec3 scale)
+{
+    return offset + vec3(q.xyz) * (1.0 / 65535.0) * scale;
+}
+
+// expects the shader to declare the position stream as positions[] and the mesh table as meshes[]
+#define loadPosition(index, meshIndex) dequantizePosition(positions[index], meshes[meshIndex].positionOffset, meshes[meshIndex].positionScale)
+
+// mesh space cluster lod error projected to pixels for the camera at the origin, lodScale is projection[1][1] * screenHeight / 2
+// inside the sphere any simplification may be arbitrarily close, so only an exact cluster projects to a finite error
+float projectClusterError(vec3 center, float radius, float error, MeshDraw meshDraw, float lodScale)
+{
+    float d = length(rotate(center, meshDraw.rotation) * meshDraw.scale + meshDraw.position) - radius * meshDraw.scale;
+
+    return d > 0 ? error * meshDraw.scale * lodScale / d : (error > 0 ? uintBitsToFloat(0x7f800000) : 0);
+}
+
+// a meshlet belongs to the cut when its own error is within the threshold and the error of its parent group isn't
+bool clusterLodCut(MeshletLod lod, MeshDraw meshDraw, float lodScale, float threshold)
+{
+    return projectClusterError(lod.center, lod.radius, lod.error, meshDraw, lodScale) <= threshold
+        && projectClusterError(lod.parentCenter, lod.parentRadius, lod.parentError, meshDraw, lodScale) > threshold;
+}
+
+// the lower hemisphere is folded over the octahedron diagonals
+vec3 decodeNormal(int8_t nu, int8_t nv)
+{
+    vec2 e = max(vec2(int(nu), int(nv)) / 127.0, vec2(-1.0));
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
+
+// screen-door cross-fade: a command with lodFade in (0, 1) keeps the pixels below the threshold,
+// the complementary command of the other lod carries -lodFade and keeps the rest, 1 draws everything
+bool lodFadeDiscard(float lodFade, vec2 fragCoord)
+{
+    const float bayer[16] = float[](0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5);
+
+    uvec2 p = uvec2(fragCoord) & 3;
+    float threshold = (bayer[p.y * 4 + p.x] + 0.5) / 16.0;
+
+    return lodFade >= 0 ? threshold >= lodFade : threshold < -lodFade;
+}
+
+// xy in framebuffer pixels for the y-flipped viewport, z keeps clip w
+vec3 screenPosition(vec4 clip, vec2 screenSize)
+{
+    vec2 ndc = clip.xy / clip.w;
+    return vec3((ndc.x * 0.5 + 0.5) * screenSize.x, (0.5 - ndc.y * 0.5) * screenSize.y, clip.w);
+}
+
+// backfacing, zero area and triangles whose bounds don't contain a pixel center are rejected
+// with VK_FRONT_FACE_CLOCKWISE in framebuffer space front faces have a positive signed area
+bool cullTriangle(vec3 a, vec3 b, vec3 c)
+{
+    // a vertex behind the camera breaks the projected shape, leave the triangle to the clipper
+    if (a.z <= 0 || b.z <= 0 || c.z <= 0)
+    {
+        return false;
+    }
+
+    vec2 ab = b.xy - a.xy;
+    vec2 ac = c.xy - a.xy;
+
+    if (ab.x * ac.y - ac.x * ab.y <= 0)
+    {
+        return true;
+    }
+
+    vec2 bmin = min(a.xy, min(b.xy, c.xy));
+    vec2 bmax = max(a.xy, max(b.xy, c.xy));
+
+    return round(bmin.x) == round(bmax.x) || round(bmin.y) == round(bmax.y);
+}
@@ -1,6 +1,7 @@
 #version 460
 
 #define DEBUG 0
+#define TRIANGLE_CULL 1
 
 #extension GL_EXT_shader_16bit_storage: require
 #extension GL_EXT_shader_8bit_storage: require
@@ -36,9 +37,13 @@ layout(binding = 2) buffer readonly Meshlets
     Meshlet meshlets[];
 };
 
-layout(binding = 3) buffer readonly MeshletData
+layout(binding = 3) buffer readonly MeshletVertices
 {
-    uint meshletData[];
+#if MESHLET_SHORT_VERTICES
+    uint16_t meshletVertices[];
+#else
+    uint meshletVertices[];
+#endif
 };
 
 layout(binding = 4) buffer readonly Vertices
@@ -46,12 +51,39 @@ layout(binding = 4) buffer readonly Vertices
     Vertex vertices[];
 };
 
+layout(binding = 5) buffer Statistics
+{
+    CullStatistics stats;
+};
+
+layout(binding = 6) buffer readonly MeshletTriangles
+{
+    uint meshletTriangles[];
+};
+
+layout(binding = 7) buffer readonly Positions
+{
+    u16vec4 positions[];
+};
+
+layout(binding = 8) buffer readonly Meshes
+{
+    MeshInstance meshes[];
+};
+
 in taskNV block 
 {
     uint meshletIndices[32];
 };
 
 layout(location = 0) out vec3 fragColor[];
+layout(location = 1) flat out uvec2 visibilityBase[];
+layout(location = 2) flat out float lodFade[];
+
+#if TRIANGLE_CULL
+shared vec3 vertexScreen[64];
+shared uint primitiveCount;
+#endif
 
 // layout(location = 1)
 // perprimitiveNV out vec3 triangleNormal[];
@@ -75,11 +107,14 @@ void main() {
     uint triangleCount = uint(meshlets[mi].triangleCount);
     uint indexCount = triangleCount * 3;
 
-    uint dataOffset = meshlets[mi].dataOffset;
-    uint vertexOffset = dataOffset;
-    uint indexOffset = dataOffset + vertexCount;
+    uint vertexBase = meshlets[mi].vertexBase;
+    uint vertexOffset = meshlets[mi].vertexOffset;
+    bool wideVertices = meshlets[mi].wideVertices != 0;
+    uint triangleOffset = meshlets[mi].triangleOffset / 4;
 
-    MeshDraw meshDraw = draws[drawCommands[gl_DrawIDARB].drawId];
+    uint drawId = drawCommands[gl_DrawIDARB].drawId;
+    float drawLodFade = drawCommands[gl_DrawIDARB].lodFade;
+    MeshDraw meshDraw = draws[drawId];
 
     #if DEBUG
         uint mhash = hash(mi);
@@ -88,30 +123,84 @@ void main() {
 
     for (uint i = ti; i < vertexCount; i += 32)
     {
-        uint vi = meshletData[vertexOffset + i] + meshDraw.vertexOffset;
+        uint vi = meshletVertex(vertexBase, vertexOffset, i, wideVertices) + meshDraw.vertexOffset;
         Vertex v = vertices[vi];
 
-        vec3 inPosition = vec3(v.vx, v.vy, v.vz);
-        vec3 inNormal = vec3(int(v.nx), int(v.ny), int(v.nz)) / 127.0 - 1.0;
+        vec3 inPosition = loadPosition(vi, meshDraw.meshIndex);
+        vec3 inNormal = decodeNormal(v.nu, v.nv);
         vec2 inTexCoord  = vec2(v.tu, v.tv);
 
-        gl_MeshVerticesNV[i].gl_Position = globals.projection * vec4(rotate(inPosition, meshDraw.rotation) * meshDraw.scale + meshDraw.position, 1.0);
+        vec4 clip = globals.projection * vec4(rotate(inPosition, meshDraw.rotation) * meshDraw.scale + meshDraw.position, 1.0);
+
+        gl_MeshVerticesNV[i].gl_Position = clip;
         fragColor[i] = normalize(inNormal) * 0.5 + 0.5;
+        visibilityBase[i] = uvec2(drawId, 0);
+        lodFade[i] = drawLodFade;
+
+    #if TRIANGLE_CULL
+        vertexScreen[i] = screenPosition(clip, vec2(globals.screenWidth, globals.screenHeight));
+    #endif
 
     #if DEBUG
         fragColor[i] = mcolor;
     #endif
     }
 
+#if TRIANGLE_CULL
+    if (ti == 0)
+    {
+        primitiveCount = 0;
+    }
+
+    barrier();
+
+    for (uint i = ti; i < triangleCount; i += 32)
+    {
+        // triangles are byte packed, 4 indices per word
+        uint index0 = triangleOffset * 4 + i * 3;
+        uint a = (meshletTriangles[(index0 + 0) / 4] >> (((index0 + 0) % 4) * 8)) & 0xff;
+        uint b = (meshletTriangles[(index0 + 1) / 4] >> (((index0 + 1) % 4) * 8)) & 0xff;
+        uint c = (meshletTriangles[(index0 + 2) / 4] >> (((index0 + 2) % 4) * 8)) & 0xff;
+
+        if (!cullTriangle(vertexScreen[a], vertexScreen[b], vertexScreen[c]))
+        {
+            uint primitive = atomicAdd(primitiveCount, 1);
+
+            gl_PrimitiveIndicesNV[primitive * 3 + 0] = a;
+            gl_PrimitiveIndicesNV[primitive * 3 + 1] = b;
+            gl_PrimitiveIndicesNV[primitive * 3 + 2] = c;
+            gl_MeshPrimitivesNV[primitive].gl_PrimitiveID = int((mi << VISIBILITY_TRIANGLE_BITS) | i);
+        }
+    }
+
+    barrier();
+
+    if (ti == 0)
+    {
+        gl_PrimitiveCountNV = primitiveCount;
+
+        if (globals.statisticsEnabled == 1)
+        {
+            atomicAdd(stats.trianglesTested, triangleCount);
+            atomicAdd(stats.trianglesRejected, triangleCount - primitiveCount);
+        }
+    }
+#else
     uint indexGroupCount = (indexCount + 3) / 4;
 
     for (uint i = ti; i < indexGroupCount; i += 32)
     {
-        writePackedPrimitiveIndices4x8NV(i * 4, meshletData[indexOffset + i]);
+        writePackedPrimitiveIndices4x8NV(i * 4, meshletTriangles[triangleOffset + i]);
+    }
+
+    for (uint i = ti; i < triangleCount; i += 32)
+    {
+        gl_MeshPrimitivesNV[i].gl_PrimitiveID = int((mi << VISIBILITY_TRIANGLE_BITS) | i);
     }
 
     if (ti == 0)
     {
         gl_PrimitiveCountNV = uint(meshlets[mi].triangleCount);
     }
+#endif
 }
\ No newline at end of file
@@ -17,6 +17,11 @@
 
 layout(local_size_x = 32, local_size_y = 1, local_size_z = 1) in;
 
+layout(push_constant) uniform block
+{
+    Globals globals;
+};
+
 out taskNV block 
 {
     uint meshletIndices[32];
@@ -37,6 +42,16 @@ layout(binding = 2) buffer readonly Meshlets
     Meshlet meshlets[];
 };
 
+layout(binding = 5) buffer Statistics
+{
+    CullStatistics stats;
+};
+
+layout(binding = 9) buffer readonly MeshletLods
+{
+    MeshletLod meshletLods[];
+};
+
 bool coneCull(vec3 center, float radius, vec3 cone_axis, float cone_cutoff , vec3 camera_position)
 {
     return dot(center - camera_position, cone_axis) >= cone_cutoff * length(center - camera_position) + radius;
@@ -45,9 +60,23 @@ bool coneCull(vec3 center, float radius, vec3 cone_axis, float cone_cutoff , vec
 void main() {
     uint mgi = gl_WorkGroupID.x;
     uint ti = gl_LocalInvocationID.x;
-    uint mi = mgi * 32 + ti;
 
-    MeshDraw meshDraw = draws[drawCommands[gl_DrawIDARB].drawId];
+    MeshDrawCommand command = drawCommands[gl_DrawIDARB];
+    MeshDraw meshDraw = draws[command.drawId];
+
+    // the last group of a draw covers fewer than 32 meshlets
+    uint groupCount = min(command.meshletCount - mgi * 32, 32);
+    uint mi = command.meshletOffset + mgi * 32 + ti;
+
+    if (ti >= groupCount)
+    {
+        mi = command.meshletOffset; // keep the lane in the ballot without reading past this lod's meshlets
+    }
+
+    // meshlets outside a cluster dag always pass, see MeshletLod
+    float lodScale = globals.projection[1][1] * 0.5 * globals.screenHeight;
+    bool inCut = ti < groupCount && clusterLodCut(meshletLods[mi], meshDraw, lodScale, globals.clusterLodThreshold);
+    bool accept = inCut;
 
 #if CULL
     vec3 center = rotate(meshlets[mi].center, meshDraw.rotation) * meshDraw.scale + meshDraw.position;
@@ -55,7 +84,8 @@ void main() {
     vec3 cone_axis = rotate(vec3(int(meshlets[mi].cone_axis[0]) / 127.0, int(meshlets[mi].cone_axis[1]) / 127.0, int(meshlets[mi].cone_axis[2]) / 127.0), meshDraw.rotation);
     float cone_cutoff = int(meshlets[mi].cone_cutoff) / 127.0;
 
-    bool accept = !coneCull(center, radius, cone_axis, cone_cutoff, vec3(0, 0, 0));
+    accept = accept && !coneCull(center, radius, cone_axis, cone_cutoff, vec3(0, 0, 0));
+#endif
 
     uvec4 ballot = subgroupBallot(accept);
     uint index = subgroupBallotExclusiveBitCount(ballot);
@@ -66,17 +96,17 @@ void main() {
     }
 
     uint count = subgroupBallotBitCount(ballot);
+    uint cutCount = subgroupBallotBitCount(subgroupBallot(inCut));
 
     if (ti == 0)
     {
         gl_TaskCountNV = count;
-    }
-#else
-    meshletIndices[ti] = mi;
 
-    if (ti == 0)
-    {
-        gl_TaskCountNV = 32;
+        if (globals.statisticsEnabled == 1)
+        {
+            atomicAdd(stats.meshletsTested, groupCount);
+            atomicAdd(stats.meshletsLodRejected, groupCount - cutCount);
+            atomicAdd(stats.meshletsConeRejected, cutCount - count);
+        }
     }
-#endif
 }
\ No newline at end of file
@@ -0,0 +1,206 @@
+#version 460
+
+#define DEBUG 0
+#define TRIANGLE_CULL 1
+
+#extension GL_EXT_shader_16bit_storage: require
+#extension GL_EXT_shader_8bit_storage: require
+#extension GL_EXT_shader_explicit_arithmetic_types: require
+#extension GL_EXT_mesh_shader: require
+
+#extension GL_GOOGLE_include_directive: require
+
+#include "mesh_struct.h"
+
+layout(local_size_x = 32, local_size_y = 1, local_size_z = 1) in;
+layout(triangles, max_vertices = 64, max_primitives = MESHLETTRICOUNT) out;
+
+layout(push_constant) uniform block
+{
+    Globals globals;
+};
+
+layout(binding = 1) buffer readonly Draws
+{
+    MeshDraw draws[];
+};
+
+layout(binding = 2) buffer readonly Meshlets
+{
+    Meshlet meshlets[];
+};
+
+layout(binding = 3) buffer readonly MeshletVertices
+{
+#if MESHLET_SHORT_VERTICES
+    uint16_t meshletVertices[];
+#else
+    uint meshletVertices[];
+#endif
+};
+
+layout(binding = 4) buffer readonly Vertices
+{
+    Vertex vertices[];
+};
+
+layout(binding = 5) buffer Statistics
+{
+    CullStatistics stats;
+};
+
+layout(binding = 6) buffer readonly MeshletTriangles
+{
+    uint8_t meshletTriangles[];
+};
+
+layout(binding = 7) buffer readonly Positions
+{
+    u16vec4 positions[];
+};
+
+layout(binding = 8) buffer readonly Meshes
+{
+    MeshInstance meshes[];
+};
+
+taskPayloadSharedEXT TaskPayload payload;
+
+layout(location = 0) out vec3 fragColor[];
+layout(location = 1) flat out uvec2 visibilityBase[];
+layout(location = 2) flat out float lodFade[];
+
+#if TRIANGLE_CULL
+// SetMeshOutputsEXT has to come before any output is written, so vertices are transformed into shared memory
+// and the surviving triangles are counted before the outputs are sized
+shared vec4 vertexClip[64];
+shared vec3 vertexScreen[64];
+shared uint acceptedTriangles[MESHLETTRICOUNT];
+shared uint primitiveCount;
+#endif
+
+uint hash(uint a)
+{
+    a = (a+0x7ed55d16) + (a<<12);
+    a = (a^0xc761c23c) ^ (a>>19);
+    a = (a+0x165667b1) + (a<<5);
+    a = (a+0xd3a2646c) ^ (a<<9);
+    a = (a+0xfd7046c5) + (a<<3);
+    a = (a^0xb55a4f09) ^ (a>>16);
+    return a;
+}
+
+void main() {
+    uint mi = payload.meshletIndices[gl_WorkGroupID.x];
+    uint ti = gl_LocalInvocationID.x;
+
+    uint vertexCount = uint(meshlets[mi].vertexCount);
+    uint triangleCount = uint(meshlets[mi].triangleCount);
+
+    uint vertexBase = meshlets[mi].vertexBase;
+    uint vertexOffset = meshlets[mi].vertexOffset;
+    bool wideVertices = meshlets[mi].wideVertices != 0;
+    uint triangleOffset = meshlets[mi].triangleOffset;
+
+    MeshDraw meshDraw = draws[payload.drawId];
+
+    #if DEBUG
+        uint mhash = hash(mi);
+        vec3 mcolor = vec3(float((mhash & 255)), float((mhash >> 8) & 255), float((mhash >> 16) & 255)) / 255.f;
+    #endif
+
+#if TRIANGLE_CULL
+    if (ti == 0)
+    {
+        primitiveCount = 0;
+    }
+
+    for (uint i = ti; i < vertexCount; i += 32)
+    {
+        uint vi = meshletVertex(vertexBase, vertexOffset, i, wideVertices) + meshDraw.vertexOffset;
+
+        vec4 clip = globals.projection * vec4(rotate(loadPosition(vi, meshDraw.meshIndex), meshDraw.rotation) * meshDraw.scale + meshDraw.position, 1.0);
+
+        vertexClip[i] = clip;
+        vertexScreen[i] = screenPosition(clip, vec2(globals.screenWidth, globals.screenHeight));
+    }
+
+    barrier();
+
+    for (uint i = ti; i < triangleCount; i += 32)
+    {
+        uint offset = triangleOffset + i * 3;
+        uint a = uint(meshletTriangles[offset]);
+        uint b = uint(meshletTriangles[offset + 1]);
+        uint c = uint(meshletTriangles[offset + 2]);
+
+        if (!cullTriangle(vertexScreen[a], vertexScreen[b], vertexScreen[c]))
+        {
+            // the source triangle rides in the top byte for the visibility buffer id
+            acceptedTriangles[atomicAdd(primitiveCount, 1)] = a | (b << 8) | (c << 16) | (i << 24);
+        }
+    }
+
+    barrier();
+
+    SetMeshOutputsEXT(vertexCount, primitiveCount);
+
+    for (uint i = ti; i < vertexCount; i += 32)
+    {
+        uint vi = meshletVertex(vertexBase, vertexOffset, i, wideVertices) + meshDraw.vertexOffset;
+        Vertex v = vertices[vi];
+
+        vec3 inNormal = decodeNormal(v.nu, v.nv);
+
+        gl_MeshVerticesEXT[i].gl_Position = vertexClip[i];
+        fragColor[i] = normalize(inNormal) * 0.5 + 0.5;
+        visibilityBase[i] = uvec2(payload.drawId, 0);
+        lodFade[i] = payload.lodFade;
+
+    #if DEBUG
+        fragColor[i] = mcolor;
+    #endif
+    }
+
+    for (uint i = ti; i < primitiveCount; i += 32)
+    {
+        uint triangle = acceptedTriangles[i];
+        gl_PrimitiveTriangleIndicesEXT[i] = uvec3(triangle & 0xff, (triangle >> 8) & 0xff, (triangle >> 16) & 0xff);
+        gl_MeshPrimitivesEXT[i].gl_PrimitiveID = int((mi << VISIBILITY_TRIANGLE_BITS) | (triangle >> 24));
+    }
+
+    if (ti == 0 && globals.statisticsEnabled == 1)
+    {
+        atomicAdd(stats.trianglesTested, triangleCount);
+        atomicAdd(stats.trianglesRejected, triangleCount - primitiveCount);
+    }
+#else
+    SetMeshOutputsEXT(vertexCount, triangleCount);
+
+    for (uint i = ti; i < vertexCount; i += 32)
+    {
+        uint vi = meshletVertex(vertexBase, vertexOffset, i, wideVertices) + meshDraw.vertexOffset;
+        Vertex v = vertices[vi];
+
+        vec3 inPosition = loadPosition(vi, meshDraw.meshIndex);
+        vec3 inNormal = decodeNormal(v.nu, v.nv);
+        vec2 inTexCoord  = vec2(v.tu, v.tv);
+
+        gl_MeshVerticesEXT[i].gl_Position = globals.projection * vec4(rotate(inPosition, meshDraw.rotation) * meshDraw.scale + meshDraw.position, 1.0);
+        fragColor[i] = normalize(inNormal) * 0.5 + 0.5;
+        visibilityBase[i] = uvec2(payload.drawId, 0);
+        lodFade[i] = payload.lodFade;
+
+    #if DEBUG
+        fragColor[i] = mcolor;
+    #endif
+    }
+
+    for (uint i = ti; i < triangleCount; i += 32)
+    {
+        uint offset = triangleOffset + i * 3;
+        gl_PrimitiveTriangleIndicesEXT[i] = uvec3(uint(meshletTriangles[offset]), uint(meshletTriangles[offset + 1]), uint(meshletTriangles[offset + 2]));
+        gl_MeshPrimitivesEXT[i].gl_PrimitiveID = int((mi << VISIBILITY_TRIANGLE_BITS) | i);
+    }
+#endif
+}
@@ -0,0 +1,125 @@
+#version 460
+
+#define CULL 1
+
+#extension GL_EXT_shader_16bit_storage: require
+#extension GL_EXT_shader_8bit_storage: require
+#extension GL_EXT_shader_explicit_arithmetic_types: require
+#extension GL_EXT_mesh_shader: require
+
+#extension GL_ARB_shader_draw_parameters : require
+
+#extension GL_GOOGLE_include_directive: require
+
+#include "mesh_struct.h"
+
+layout(local_size_x = 32, local_size_y = 1, local_size_z = 1) in;
+
+layout(push_constant) uniform block
+{
+    Globals globals;
+};
+
+taskPayloadSharedEXT TaskPayload payload;
+
+layout(binding = 0) buffer readonly DrawCommands
+{
+    MeshDrawCommand drawCommands[];
+};
+
+layout(binding = 1) buffer readonly Draws
+{
+    MeshDraw draws[];
+};
+
+layout(binding = 2) buffer readonly Meshlets
+{
+    Meshlet meshlets[];
+};
+
+layout(binding = 5) buffer Statistics
+{
+    CullStatistics stats;
+};
+
+layout(binding = 9) buffer readonly MeshletLods
+{
+    MeshletLod meshletLods[];
+};
+
+// subgroup sizes differ between vendors, so accepted meshlets are compacted through shared memory instead of a ballot
+shared uint acceptedCount;
+shared uint cutCount;
+
+bool coneCull(vec3 center, float radius, vec3 cone_axis, float cone_cutoff , vec3 camera_position)
+{
+    return dot(center - camera_position, cone_axis) >= cone_cutoff * length(center - camera_position) + radius;
+}
+
+void main() {
+    // large draws spill into y, see drawcmd.comp.glsl
+    uint mgi = gl_WorkGroupID.x + gl_WorkGroupID.y * gl_NumWorkGroups.x;
+    uint ti = gl_LocalInvocationID.x;
+
+    MeshDrawCommand command = drawCommands[gl_DrawIDARB];
+    MeshDraw meshDraw = draws[command.drawId];
+
+    // the last group of a draw covers fewer than 32 meshlets, groups past the end of the y spill cover none
+    uint groupCount = mgi * 32 < command.meshletCount ? min(command.meshletCount - mgi * 32, 32) : 0;
+    uint mi = command.meshletOffset + mgi * 32 + ti;
+
+    if (ti == 0)
+    {
+        acceptedCount = 0;
+        cutCount = 0;
+        payload.drawId = command.drawId;
+        payload.lodFade = command.lodFade;
+    }
+
+    barrier();
+
+    bool accept = ti < groupCount;
+
+    // meshlets outside a cluster dag always pass, see MeshletLod
+    if (accept)
+    {
+        float lodScale = globals.projection[1][1] * 0.5 * globals.screenHeight;
+        accept = clusterLodCut(meshletLods[mi], meshDraw, lodScale, globals.clusterLodThreshold);
+
+        if (accept && globals.statisticsEnabled == 1)
+        {
+            atomicAdd(cutCount, 1);
+        }
+    }
+
+#if CULL
+    if (accept)
+    {
+        vec3 center = rotate(meshlets[mi].center, meshDraw.rotation) * meshDraw.scale + meshDraw.position;
+        float radius = meshlets[mi].radius * meshDraw.scale;
+        vec3 cone_axis = rotate(vec3(int(meshlets[mi].cone_axis[0]) / 127.0, int(meshlets[mi].cone_axis[1]) / 127.0, int(meshlets[mi].cone_axis[2]) / 127.0), meshDraw.rotation);
+        float cone_cutoff = int(meshlets[mi].cone_cutoff) / 127.0;
+
+        accept = !coneCull(center, radius, cone_axis, cone_cutoff, vec3(0, 0, 0));
+    }
+#endif
+
+    if (accept)
+    {
+        uint index = atomicAdd(acceptedCount, 1);
+        payload.meshletIndices[index] = mi;
+    }
+
+    barrier();
+
+    uint count = acceptedCount;
+
+    if (ti == 0 && globals.statisticsEnabled == 1)
+    {
+        atomicAdd(stats.meshletsTested, groupCount);
+        atomicAdd(stats.meshletsLodRejected, groupCount - cutCount);
+        atomicAdd(stats.meshletsConeRejected, cutCount - count);
+    }
+
+    EmitMeshTasksEXT(count, 1, 1);
+}
@@ -0,0 +1,228 @@
+#version 460
+
+#extension GL_EXT_shader_16bit_storage: require
+#extension GL_EXT_shader_8bit_storage: require
+#extension GL_EXT_shader_explicit_arithmetic_types: require
+
+#extension GL_GOOGLE_include_directive: require
+
+#include "mesh_struct.h"
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+layout(push_constant) uniform block
+{
+    vec4 frustum[6];
+    uint indexOffset;
+    uint indexCapacity;
+    int cullingEnabled;
+    int statisticsEnabled;
+    float clusterLodScale;
+    float clusterLodThreshold;
+};
+
+layout(binding = 0) buffer readonly DrawCommands
+{
+    MeshDrawCommand drawCommands[];
+};
+
+layout(binding = 1) buffer DrawCommandCount
+{
+    uint drawCommandCount;
+    uint meshletCullGroupCountX;
+    uint meshletCullGroupCountY;
+    uint meshletCullGroupCountZ;
+    uint meshletCullIndexCount;
+};
+
+layout(binding = 2) buffer readonly Draws
+{
+    MeshDraw draws[];
+};
+
+layout(binding = 3) buffer readonly Meshlets
+{
+    Meshlet meshlets[];
+};
+
+layout(binding = 4) buffer readonly MeshletVertices
+{
+#if MESHLET_SHORT_VERTICES
+    uint16_t meshletVertices[];
+#else
+    uint meshletVertices[];
+#endif
+};
+
+layout(binding = 5) buffer readonly MeshletTriangles
+{
+    uint8_t meshletTriangles[];
+};
+
+layout(binding = 6) buffer writeonly MeshletDrawCommands
+{
+    MeshDrawCommand meshletDrawCommands[];
+};
+
+layout(binding = 7) buffer writeonly Indices
+{
+    uint indices[];
+};
+
+layout(binding = 8) buffer Statistics
+{
+    CullStatistics stats;
+};
+
+layout(binding = 9) buffer readonly MeshletLods
+{
+    MeshletLod meshletLods[];
+};
+
+shared uint drawFirstIndex;
+shared uint drawIndexCount;
+
+shared uint acceptedCount;
+shared uint cutCount;
+shared uint frustumRejectedCount;
+shared uint acceptedMeshlets[64];
+shared uint acceptedFirstIndex[64];
+
+bool coneCull(vec3 center, float radius, vec3 cone_axis, float cone_cutoff , vec3 camera_position)
+{
+    return dot(center - camera_position, cone_axis) >= cone_cutoff * length(center - camera_position) + radius;
+}
+
+void main()
+{
+    // one workgroup per draw command, see drawcmd.comp.glsl for the y spill
+    uint dci = gl_WorkGroupID.x + gl_WorkGroupID.y * gl_NumWorkGroups.x;
+    uint ti = gl_LocalInvocationID.x;
+
+    if (dci >= drawCommandCount)
+    {
+        return;
+    }
+
+    MeshDrawCommand command = drawCommands[dci];
+    MeshDraw meshDraw = draws[command.drawId];
+
+    if (ti == 0)
+    {
+        // the whole lod is reserved up front and the surviving triangles are packed at its start
+        // checking before the atomic keeps the counter from wrapping once the region is full
+        uint first = meshletCullIndexCount < indexCapacity ? atomicAdd(meshletCullIndexCount, command.indexCount) : indexCapacity;
+
+        drawFirstIndex = first + command.indexCount <= indexCapacity ? indexOffset + first : ~0u;
+        drawIndexCount = 0;
+    }
+
+    barrier();
+
+    // out of space: draw the whole lod from the copy of the mesh indices
+    if (drawFirstIndex == ~0u)
+    {
+        if (ti == 0)
+        {
+            meshletDrawCommands[dci] = command;
+        }
+        return;
+    }
+
+    for (uint base = 0; base < command.meshletCount; base += 64)
+    {
+        if (ti == 0)
+        {
+            acceptedCount = 0;
+            cutCount = 0;
+            frustumRejectedCount = 0;
+        }
+
+        barrier();
+
+        uint mi = command.meshletOffset + base + ti;
+        bool accept = base + ti < command.meshletCount;
+
+        // meshlets outside a cluster dag always pass, see MeshletLod
+        if (accept)
+        {
+            accept = clusterLodCut(meshletLods[mi], meshDraw, clusterLodScale, clusterLodThreshold);
+
+            if (accept && statisticsEnabled == 1)
+            {
+                atomicAdd(cutCount, 1);
+            }
+        }
+
+        if (accept && cullingEnabled == 1)
+        {
+            vec3 center = rotate(meshlets[mi].center, meshDraw.rotation) * meshDraw.scale + meshDraw.position;
+            float radius = meshlets[mi].radius * meshDraw.scale;
+            vec3 cone_axis = rotate(vec3(int(meshlets[mi].cone_axis[0]) / 127.0, int(meshlets[mi].cone_axis[1]) / 127.0, int(meshlets[mi].cone_axis[2]) / 127.0), meshDraw.rotation);
+            float cone_cutoff = int(meshlets[mi].cone_cutoff) / 127.0;
+
+            for (int i = 0; i < 6; ++i)
+            {
+                accept = accept && (dot(vec4(center, 1), frustum[i]) > -radius);
+            }
+
+            if (!accept && statisticsEnabled == 1)
+            {
+                atomicAdd(frustumRejectedCount, 1);
+            }
+
+            accept = accept && !coneCull(center, radius, cone_axis, cone_cutoff, vec3(0, 0, 0));
+        }
+
+        if (accept)
+        {
+            uint slot = atomicAdd(acceptedCount, 1);
+
+            acceptedMeshlets[slot] = mi;
+            acceptedFirstIndex[slot] = atomicAdd(drawIndexCount, uint(meshlets[mi].triangleCount) * 3);
+        }
+
+        barrier();
+
+        if (ti == 0 && statisticsEnabled == 1)
+        {
+            uint testedCount = min(command.meshletCount - base, 64);
+
+            atomicAdd(stats.meshletsTested, testedCount);
+            atomicAdd(stats.meshletsLodRejected, testedCount - cutCount);
+            atomicAdd(stats.meshletsFrustumRejected, frustumRejectedCount);
+            atomicAdd(stats.meshletsConeRejected, cutCount - frustumRejectedCount - acceptedCount);
+        }
+
+        // the whole group expands each accepted meshlet so that index writes stay coalesced
+        for (uint j = 0; j < acceptedCount; ++j)
+        {
+            uint ami = acceptedMeshlets[j];
+
+            uint vertexBase = meshlets[ami].vertexBase;
+            uint vertexOffset = meshlets[ami].vertexOffset;
+            bool wideVertices = meshlets[ami].wideVertices != 0;
+            uint triangleOffset = meshlets[ami].triangleOffset;
+            uint indexCount = uint(meshlets[ami].triangleCount) * 3;
+            uint outputOffset = drawFirstIndex + acceptedFirstIndex[j];
+
+            for (uint k = ti; k < indexCount; k += 64)
+            {
+                indices[outputOffset + k] = meshletVertex(vertexBase, vertexOffset, uint(meshletTriangles[triangleOffset + k]), wideVertices);
+            }
+        }
+
+        barrier();
+    }
+
+    if (ti == 0)
+    {
+        meshletDrawCommands[dci].drawId = command.drawId;
+        meshletDrawCommands[dci].indexCount = drawIndexCount;
+        meshletDrawCommands[dci].instanceCount = 1;
+        meshletDrawCommands[dci].firstIndex = drawFirstIndex;
+        meshletDrawCommands[dci].vertexOffset = command.vertexOffset;
+        meshletDrawCommands[dci].firstInstance = 0;
+        meshletDrawCommands[dci].lodFade = command.lodFade;
+    }
+}
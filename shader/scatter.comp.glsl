@@ -0,0 +1,41 @@
+#version 460
+
+// writes packed elements to scattered places of a buffer, one thread per word so that neighbouring threads read neighbouring words
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+layout(push_constant) uniform block
+{
+    uint wordCount;
+    uint elementWords;
+};
+
+layout(binding = 0) buffer readonly Indices
+{
+    uint indices[];
+};
+
+layout(binding = 1) buffer readonly Payload
+{
+    uint payload[];
+};
+
+layout(binding = 2) buffer writeonly Target
+{
+    uint target[];
+};
+
+void main()
+{
+    // large updates spill into y past 65535 groups
+    uint wi = (gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x) * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
+
+    if (wi >= wordCount)
+    {
+        return;
+    }
+
+    uint element = wi / elementWords;
+    uint word = wi - element * elementWords;
+
+    target[indices[element] * elementWords + word] = payload[wi];
+}
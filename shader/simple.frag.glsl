@@ -1,12 +1,31 @@
 #version 460
 
-#extension GL_NV_mesh_shader: require
+#extension GL_EXT_shader_16bit_storage: require
+#extension GL_EXT_shader_8bit_storage: require
+#extension GL_EXT_shader_explicit_arithmetic_types: require
+
+#extension GL_GOOGLE_include_directive: require
+
+#include "mesh_struct.h"
+
+// the dither discard costs early depth testing, so it is only compiled into the LOD_FADE variant that is bound while lod fading is on
+#ifndef LOD_FADE
+#define LOD_FADE 0
+#endif
 
 layout(location = 0) in vec3 fragColor;
+layout(location = 2) flat in float lodFade;
 // layout(location = 1) perprimitiveNV in vec3 triangleNormal;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
+#if LOD_FADE
+    if (lodFadeDiscard(lodFade, gl_FragCoord.xy))
+    {
+        discard;
+    }
+#endif
+
     outColor = vec4(fragColor, 1.0);
 }
\ No newline at end of file
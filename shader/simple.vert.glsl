@@ -30,21 +30,41 @@ layout(binding = 2) buffer readonly Vertices
     Vertex vertices[];
 };
 
+layout(binding = 3) buffer readonly Positions
+{
+    u16vec4 positions[];
+};
+
+layout(binding = 4) buffer readonly Meshes
+{
+    MeshInstance meshes[];
+};
+
 // layout(location = 0) in vec3 inPosition;
 // layout(location = 1) in vec3 inNormal;
 // layout(location = 2) in vec2 inTexCoord;
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) flat out uvec2 visibilityBase;
+layout(location = 2) flat out float lodFade;
+
+// must match depth.vert.glsl for the EQUAL test after the depth prepass
+invariant gl_Position;
 
 void main() {
     Vertex v = vertices[gl_VertexIndex];
 
-    MeshDraw meshDraw = draws[drawCommands[gl_DrawIDARB].drawId];
+    MeshDrawCommand command = drawCommands[gl_DrawIDARB];
+    MeshDraw meshDraw = draws[command.drawId];
 
-    vec3 inPosition = vec3(v.vx, v.vy, v.vz);
-    vec3 inNormal = vec3(int(v.nx), int(v.ny), int(v.nz)) / 127.0 - 1.0;
+    vec3 inPosition = loadPosition(gl_VertexIndex, meshDraw.meshIndex);
+    vec3 inNormal = decodeNormal(v.nu, v.nv);
     vec2 inTexCoord  = vec2(v.tu, v.tv);
 
     gl_Position = globals.projection * vec4(rotate(inPosition, meshDraw.rotation) * meshDraw.scale + meshDraw.position, 1.0);
     fragColor = normalize(inNormal) * 0.5 + 0.5;
+
+    // gl_PrimitiveID restarts at 0 for every draw, so the first triangle of the draw is passed along
+    visibilityBase = uvec2(command.drawId, command.firstIndex / 3);
+    lodFade = command.lodFade;
 }
\ No newline at end of file
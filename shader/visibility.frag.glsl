@@ -0,0 +1,30 @@
+#version 460
+
+#extension GL_EXT_shader_16bit_storage: require
+#extension GL_EXT_shader_8bit_storage: require
+#extension GL_EXT_shader_explicit_arithmetic_types: require
+
+#extension GL_GOOGLE_include_directive: require
+
+#include "mesh_struct.h"
+
+// the dither discard costs early depth testing, so it is only compiled into the LOD_FADE variant that is bound while lod fading is on
+#ifndef LOD_FADE
+#define LOD_FADE 0
+#endif
+
+layout(location = 1) flat in uvec2 visibilityBase;
+layout(location = 2) flat in float lodFade;
+
+layout(location = 0) out uvec2 outVisibility;
+
+void main() {
+#if LOD_FADE
+    if (lodFadeDiscard(lodFade, gl_FragCoord.xy))
+    {
+        discard;
+    }
+#endif
+
+    outVisibility = uvec2(visibilityBase.x, visibilityBase.y + uint(gl_PrimitiveID));
+}
@@ -0,0 +1,129 @@
+#version 460
+
+#extension GL_EXT_shader_16bit_storage: require
+#extension GL_EXT_shader_8bit_storage: require
+#extension GL_EXT_shader_explicit_arithmetic_types: require
+
+#extension GL_GOOGLE_include_directive: require
+
+#include "mesh_struct.h"
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+layout(push_constant) uniform block
+{
+    mat4 projection;
+    float screenWidth;
+    float screenHeight;
+    int meshShading;
+};
+
+layout(binding = 0, rg32ui) uniform readonly uimage2D visibilityImage;
+layout(binding = 1, rgba8) uniform writeonly image2D outImage;
+
+layout(binding = 2) buffer readonly Draws
+{
+    MeshDraw draws[];
+};
+
+layout(binding = 3) buffer readonly Meshlets
+{
+    Meshlet meshlets[];
+};
+
+layout(binding = 4) buffer readonly MeshletVertices
+{
+#if MESHLET_SHORT_VERTICES
+    uint16_t meshletVertices[];
+#else
+    uint meshletVertices[];
+#endif
+};
+
+layout(binding = 5) buffer readonly MeshletTriangles
+{
+    uint8_t meshletTriangles[];
+};
+
+layout(binding = 6) buffer readonly Indices
+{
+    uint indices[];
+};
+
+layout(binding = 7) buffer readonly Vertices
+{
+    Vertex vertices[];
+};
+
+layout(binding = 8) buffer readonly Positions
+{
+    u16vec4 positions[];
+};
+
+layout(binding = 9) buffer readonly Meshes
+{
+    MeshInstance meshes[];
+};
+
+// mesh relative vertex indices of the triangle named by a visibility id, see VISIBILITY_TRIANGLE_BITS
+uvec3 triangleVertices(uint triangle)
+{
+    if (meshShading == 1)
+    {
+        uint mi = triangle >> VISIBILITY_TRIANGLE_BITS;
+        uint offset = meshlets[mi].triangleOffset + (triangle & ((1 << VISIBILITY_TRIANGLE_BITS) - 1)) * 3;
+        uint vertexBase = meshlets[mi].vertexBase;
+        uint vertexOffset = meshlets[mi].vertexOffset;
+        bool wideVertices = meshlets[mi].wideVertices != 0;
+
+        return uvec3(
+            meshletVertex(vertexBase, vertexOffset, uint(meshletTriangles[offset + 0]), wideVertices),
+            meshletVertex(vertexBase, vertexOffset, uint(meshletTriangles[offset + 1]), wideVertices),
+            meshletVertex(vertexBase, vertexOffset, uint(meshletTriangles[offset + 2]), wideVertices));
+    }
+
+    return uvec3(indices[triangle * 3 + 0], indices[triangle * 3 + 1], indices[triangle * 3 + 2]);
+}
+
+void main()
+{
+    uvec2 pos = gl_GlobalInvocationID.xy;
+
+    if (pos.x >= uint(screenWidth) || pos.y >= uint(screenHeight))
+    {
+        return;
+    }
+
+    uvec2 id = imageLoad(visibilityImage, ivec2(pos)).xy;
+
+    if (id.x == ~0u)
+    {
+        imageStore(outImage, ivec2(pos), vec4(0, 0, 0, 1));
+        return;
+    }
+
+    MeshDraw meshDraw = draws[id.x];
+    uvec3 tri = triangleVertices(id.y) + meshDraw.vertexOffset;
+
+    vec4 clip[3];
+    vec3 color[3];
+
+    for (int k = 0; k < 3; ++k)
+    {
+        Vertex v = vertices[tri[k]];
+
+        clip[k] = projection * vec4(rotate(loadPosition(tri[k], meshDraw.meshIndex), meshDraw.rotation) * meshDraw.scale + meshDraw.position, 1.0);
+        color[k] = normalize(decodeNormal(v.nu, v.nv)) * 0.5 + 0.5;
+    }
+
+    // perspective correct barycentrics straight from clip space, which stays valid for triangles crossing w = 0
+    // the viewport is y-flipped, so framebuffer y grows towards -ndc.y
+    vec2 ndc = vec2((float(pos.x) + 0.5) / screenWidth * 2.0 - 1.0, 1.0 - (float(pos.y) + 0.5) / screenHeight * 2.0);
+
+    vec3 bary = inverse(mat3(clip[0].xyw, clip[1].xyw, clip[2].xyw)) * vec3(ndc, 1.0);
+    bary /= bary.x + bary.y + bary.z;
+
+    vec3 shaded = color[0] * bary.x + color[1] * bary.y + color[2] * bary.z;
+
+    imageStore(outImage, ivec2(pos), vec4(shaded, 1.0));
+}